@@ -0,0 +1,261 @@
+#include "audio_guard.h"
+
+#if defined(RASKOL_AUDIO_GUARD)
+
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// The interposed calls have to replace libc's for the whole process, and
+// hosts scope their own callbacks, so a guard build exports all of this
+// from libraskol despite its hidden default.
+#pragma GCC visibility push(default)
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void  __libc_free(void *ptr);
+}
+
+static __thread int depth;
+static std::atomic<unsigned long> allocations(0);
+static std::atomic<unsigned long> syscalls(0);
+static std::atomic<bool> fatal(true);
+
+static void raw_write(const char *s) {
+    syscall(SYS_write, 2, s, strlen(s));
+}
+
+static void violation(const char *what, std::atomic<unsigned long> *counter) {
+    counter->fetch_add(1);
+    if (!fatal.load())
+        return;
+
+    // Reporting calls into libc too; make sure it cannot trip the guard.
+    depth = 0;
+    raw_write("audio guard: ");
+    raw_write(what);
+    raw_write(" called on the audio thread\n");
+
+    void *frames[64];
+    int n = backtrace(frames, 64);
+    backtrace_symbols_fd(frames, n, 2);
+    abort();
+}
+
+#define CHECK_ALLOC(name)   do { if (depth > 0) violation(name, &allocations); } while (0)
+#define CHECK_SYSCALL(name) do { if (depth > 0) violation(name, &syscalls); } while (0)
+
+// Resolved without function-local statics: their guards may lock.
+#define REAL(name) \
+    static decltype(&::name) real_##name; \
+    static decltype(&::name) resolve_##name() { \
+        if (real_##name == NULL) \
+            real_##name = (decltype(&::name))dlsym(RTLD_NEXT, #name); \
+        return real_##name; \
+    }
+
+REAL(read)
+REAL(write)
+REAL(open)
+REAL(close)
+REAL(poll)
+REAL(nanosleep)
+REAL(usleep)
+REAL(fsync)
+REAL(pthread_mutex_lock)
+
+void audio_guard_init() {
+    resolve_read();
+    resolve_write();
+    resolve_open();
+    resolve_close();
+    resolve_poll();
+    resolve_nanosleep();
+    resolve_usleep();
+    resolve_fsync();
+    resolve_pthread_mutex_lock();
+
+    // The first backtrace() loads libgcc and allocates; get that over with.
+    void *frames[4];
+    backtrace(frames, 4);
+}
+
+void audio_guard_enter() {
+    depth++;
+}
+
+void audio_guard_leave() {
+    depth--;
+}
+
+void audio_guard_set_fatal(bool value) {
+    fatal.store(value);
+}
+
+unsigned long audio_guard_allocations() {
+    return allocations.load();
+}
+
+unsigned long audio_guard_syscalls() {
+    return syscalls.load();
+}
+
+void audio_guard_reset() {
+    allocations.store(0);
+    syscalls.store(0);
+}
+
+extern "C" {
+
+void *malloc(size_t size) {
+    CHECK_ALLOC("malloc");
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    CHECK_ALLOC("calloc");
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    CHECK_ALLOC("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+    CHECK_ALLOC("posix_memalign");
+    void *p = __libc_memalign(alignment, size);
+    if (p == NULL)
+        return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    CHECK_ALLOC("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+void free(void *ptr) {
+    if (ptr != NULL)
+        CHECK_ALLOC("free");
+    __libc_free(ptr);
+}
+
+ssize_t read(int fd, void *buf, size_t count) {
+    CHECK_SYSCALL("read");
+    return resolve_read()(fd, buf, count);
+}
+
+ssize_t write(int fd, const void *buf, size_t count) {
+    CHECK_SYSCALL("write");
+    return resolve_write()(fd, buf, count);
+}
+
+int open(const char *path, int flags, ...) {
+    CHECK_SYSCALL("open");
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    return resolve_open()(path, flags, mode);
+}
+
+int close(int fd) {
+    CHECK_SYSCALL("close");
+    return resolve_close()(fd);
+}
+
+int poll(pollfd *fds, nfds_t count, int timeout) {
+    CHECK_SYSCALL("poll");
+    return resolve_poll()(fds, count, timeout);
+}
+
+int nanosleep(const timespec *request, timespec *remaining) {
+    CHECK_SYSCALL("nanosleep");
+    return resolve_nanosleep()(request, remaining);
+}
+
+int usleep(useconds_t usec) {
+    CHECK_SYSCALL("usleep");
+    return resolve_usleep()(usec);
+}
+
+int fsync(int fd) {
+    CHECK_SYSCALL("fsync");
+    return resolve_fsync()(fd);
+}
+
+int pthread_mutex_lock(pthread_mutex_t *mutex) {
+    CHECK_SYSCALL("pthread_mutex_lock");
+    return resolve_pthread_mutex_lock()(mutex);
+}
+
+}
+
+void *operator new(size_t size) {
+    CHECK_ALLOC("operator new");
+    void *p = __libc_malloc(size != 0 ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size) {
+    CHECK_ALLOC("operator new[]");
+    void *p = __libc_malloc(size != 0 ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    CHECK_ALLOC("operator new");
+    return __libc_malloc(size != 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    CHECK_ALLOC("operator new[]");
+    return __libc_malloc(size != 0 ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept {
+    if (ptr != NULL)
+        CHECK_ALLOC("operator delete");
+    __libc_free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    if (ptr != NULL)
+        CHECK_ALLOC("operator delete[]");
+    __libc_free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    operator delete[](ptr);
+}
+
+#pragma GCC visibility pop
+
+#endif
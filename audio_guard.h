@@ -0,0 +1,41 @@
+#ifndef RASKOL_AUDIO_GUARD_H
+#define RASKOL_AUDIO_GUARD_H
+
+// Debug-build detector for allocations and blocking calls on the audio
+// thread. With RASKOL_AUDIO_GUARD defined, malloc/free, operator new/delete
+// and a set of blocking libc calls are intercepted; any of them made inside
+// an audio_guard_scope either aborts with a backtrace (the default) or is
+// counted, so a test can assert that a block rendered without any.
+// Without RASKOL_AUDIO_GUARD everything here compiles away.
+
+#if defined(RASKOL_AUDIO_GUARD)
+
+void audio_guard_init();
+void audio_guard_enter();
+void audio_guard_leave();
+
+// false counts violations instead of aborting.
+void audio_guard_set_fatal(bool fatal);
+
+unsigned long audio_guard_allocations();
+unsigned long audio_guard_syscalls();
+void audio_guard_reset();
+
+#else
+
+inline void audio_guard_init() {}
+inline void audio_guard_enter() {}
+inline void audio_guard_leave() {}
+inline void audio_guard_set_fatal(bool) {}
+inline unsigned long audio_guard_allocations() { return 0; }
+inline unsigned long audio_guard_syscalls() { return 0; }
+inline void audio_guard_reset() {}
+
+#endif
+
+struct audio_guard_scope {
+    audio_guard_scope() { audio_guard_enter(); }
+    ~audio_guard_scope() { audio_guard_leave(); }
+};
+
+#endif
@@ -0,0 +1,290 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "graph.h"
+#include "kernels.h"
+#include "limiter.h"
+#include "pcm.h"
+#include "resampler.h"
+#include "voice_rate.h"
+#include "waveguide.h"
+
+const unsigned long BLOCK   = 512;
+const unsigned long SECONDS = 20;
+
+static void report(const char *name, double seconds, unsigned long samples) {
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(2)
+              << seconds * 1e9 / samples << " ns/sample"
+              << std::setw(12) << samples / seconds / 1e6 << " Msamples/s" << std::endl;
+}
+
+static void bench_resampler(int in_rate, int out_rate) {
+    resampler r;
+    resampler_init(&r, in_rate, out_rate, BLOCK);
+
+    std::vector<float> in(resampler_max_input(&r));
+    std::vector<float> out(BLOCK);
+    double phase = 0.0;
+
+    unsigned long total = (unsigned long)out_rate * SECONDS;
+    unsigned long done  = 0;
+    double elapsed = 0.0;
+
+    while (done < total) {
+        unsigned long needed = resampler_input_needed(&r, BLOCK);
+        for (unsigned long i = 0; i < needed; i++) {
+            in[i] = (float)sin(phase);
+            phase += 2.0 * M_PI * 440.0 / in_rate;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        resampler_process(&r, in.data(), needed, out.data(), BLOCK);
+        elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        done += BLOCK;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "resample %d -> %d%s", in_rate, out_rate, r.exact ? "" : " (interp)");
+    report(name, elapsed, done);
+}
+
+// One voice through the block render path: envelope, oscillator and mix.
+static void bench_voice(const dsp_kernels *k, int waveform, const char *label) {
+    std::vector<float> wave(BLOCK), volume(BLOCK), sum(BLOCK, 0.0f);
+    float phase     = 0.0f;
+    float level     = 0.0f;
+    float d_level   = 3.0f;
+    float increment = (float)(2.0 * M_PI * 440.0 / 44100);
+
+    unsigned long total = 44100 * SECONDS;
+    unsigned long done  = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (done < total) {
+        k->envelope(&level, &d_level, 1.0f / 44100, volume.data(), BLOCK);
+        k->oscillator(waveform, &phase, increment, wave.data(), BLOCK);
+        k->mix(sum.data(), wave.data(), volume.data(), BLOCK);
+        done += BLOCK;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    char name[64];
+    snprintf(name, sizeof(name), "voice %s", label);
+    report(name, elapsed, done);
+}
+
+// Master limiter on a signal hot enough to keep it reducing gain.
+static void bench_limiter(const dsp_kernels *k) {
+    limiter l;
+    limiter_init(&l, 44100);
+    std::vector<float> block(BLOCK);
+    double phase = 0.0;
+
+    unsigned long total = 44100 * SECONDS;
+    unsigned long done  = 0;
+    double elapsed = 0.0;
+    while (done < total) {
+        for (unsigned long i = 0; i < BLOCK; i++) {
+            block[i] = (float)(1.5 * sin(phase));
+            phase += 2.0 * M_PI * 440.0 / 44100;
+        }
+        auto start = std::chrono::steady_clock::now();
+        limiter_process(&l, k, block.data(), BLOCK);
+        elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        done += BLOCK;
+    }
+    report("limiter", elapsed, done);
+}
+
+// Device conversion of one callback's output, dither included.
+static void bench_pcm(const dsp_kernels *k, int format, int channels, int dither) {
+    pcm_converter c;
+    pcm_init(&c, format, channels, dither, BLOCK);
+    std::vector<float> block(BLOCK);
+    for (unsigned long i = 0; i < BLOCK; i++)
+        block[i] = (float)(0.9 * sin(2.0 * M_PI * 440.0 * i / 44100));
+    std::vector<int> out(BLOCK * channels);
+
+    unsigned long total = 44100 * SECONDS;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long done = 0; done < total; done += BLOCK)
+        pcm_convert(&c, k->convert, block.data(), out.data(), BLOCK);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    char name[64];
+    snprintf(name, sizeof(name), "pcm %s x%d %s", PCM_NAMES[format], channels, DITHER_NAMES[c.dither]);
+    report(name, elapsed, total);
+}
+
+// One voice as the multirate render runs it, in engine-sized blocks: the
+// envelope from points and the oscillator at the rate its pitch allows.
+static void bench_multirate(const dsp_kernels *k, int waveform, float frequency, const char *label) {
+    const unsigned long block = 64;
+    voice_rates rates;
+    voice_rates_init(&rates, 1.0f / 44100);
+    std::vector<float> wave(block), volume(block), low(block), sum(block, 0.0f);
+    float phase     = 0.0f;
+    float level     = 0.0f;
+    float d_level   = 3.0f;
+    float increment = (float)(2.0 * M_PI * frequency / 44100);
+    int shift       = voice_rate(waveform, increment);
+
+    unsigned long total = 44100 * SECONDS;
+    unsigned long done  = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (done < total) {
+        if (!voice_envelope(&rates, &level, &d_level, 1.0f / 44100, volume.data(), block))
+            k->envelope(&level, &d_level, 1.0f / 44100, volume.data(), block);
+        if (shift > 0)
+            voice_oscillator(&rates, k, waveform, &phase, increment, shift, low.data(), wave.data(), block);
+        else
+            k->oscillator(waveform, &phase, increment, wave.data(), block);
+        k->mix(sum.data(), wave.data(), volume.data(), block);
+        done += block;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    char name[64];
+    snprintf(name, sizeof(name), "voice %s 1/%d", label, 1 << shift);
+    report(name, elapsed, done);
+}
+
+// A plucked string voice; the delay line loop is scalar, so it only runs
+// once rather than per ISA.
+static void bench_string() {
+    patch p;
+    patch_defaults(&p);
+    string_bank s;
+    strings_init(&s, 1);
+    string_excite(&s, 0, &p, 440.0f, 44100);
+    std::vector<float> out(BLOCK);
+
+    unsigned long total = 44100 * SECONDS;
+    unsigned long done  = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (done < total) {
+        string_render(&s, 0, out.data(), BLOCK);
+        done += BLOCK;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report("voice string", elapsed, done);
+}
+
+// Overlapping grains reading a noise source through a window table; the
+// rate reports grain samples, so it is the per-grain cost.
+static void bench_grains(const dsp_kernels *k) {
+    const unsigned mask  = (1 << 16) - 1;
+    const int      count = 64;
+    std::vector<float> source(mask + 1), window(1025), out(BLOCK);
+    uint32_t random = 1;
+    for (size_t i = 0; i < source.size(); i++) {
+        random = random * 1664525u + 1013904223u;
+        source[i] = (float)(random >> 8) / 8388608.0f - 1.0f;
+    }
+    for (size_t i = 0; i < window.size(); i++)
+        window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / 1024));
+
+    unsigned long total = 44100 * SECONDS;
+    unsigned long done  = 0;
+    unsigned base = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (done < total) {
+        for (int g = 0; g < count; g++) {
+            float rate = 0.5f + g * (1.5f / count);
+            k->grain(source.data(), mask, base + g * 997, 0.25f, rate, window.data(),
+                     (float)(g * 8), 0.5f, 0.1f, out.data(), BLOCK);
+        }
+        base += BLOCK;
+        done += BLOCK;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report("grains (x64)", elapsed, done * count);
+}
+
+// Four oscillator -> filter -> delay branches on a bus, in engine-sized
+// blocks; with workers the branches of each level run in parallel.
+static void bench_graph(const dsp_kernels *k, int workers) {
+    const unsigned long block = 64;
+    std::string spec;
+    for (int i = 0; i < 4; i++) {
+        char branch[256];
+        snprintf(branch, sizeof(branch),
+                 "osc%d osc waveform=saw freq=%d\n"
+                 "filter%d filter osc%d mode=lowpass cutoff=%d q=4\n"
+                 "delay%d delay filter%d time=0.%d feedback=0.7\n",
+                 i, 110 * (i + 1), i, i, 500 * (i + 1), i, i, i + 1);
+        spec += branch;
+    }
+    spec += "out bus delay0 delay1 delay2 delay3\n";
+
+    graph *g = NULL;
+    if (!graph_compile(spec, "bench graph", 44100, block, &g))
+        return;
+    rt_mode rt;
+    rt_defaults(&rt);
+    graph_workers w;
+    graph_workers_init(&w);
+    graph_workers_start(&w, workers, &rt);
+    std::vector<float> out(block);
+
+    unsigned long total = 44100 * SECONDS;
+    unsigned long done  = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (done < total) {
+        graph_run(g, &w, NULL, k, out.data(), block);
+        done += block;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    graph_workers_stop(&w);
+    graph_free(g);
+
+    char name[64];
+    snprintf(name, sizeof(name), "graph 13 nodes, %d workers", workers);
+    report(name, elapsed, done);
+}
+
+int main() {
+    for (int i = 0; i < DSP_ISA_COUNT; i++) {
+        if (!dsp_select(DSP_ISAS[i])) {
+            std::cout << "[" << DSP_ISAS[i] << "] not supported on this CPU" << std::endl;
+            continue;
+        }
+        std::cout << "[" << DSP_ISAS[i] << "]" << std::endl;
+
+        bench_resampler(44100, 48000);
+        bench_resampler(48000, 44100);
+        bench_resampler(44100, 96000);
+        bench_resampler(44100, 47999);
+
+        bench_voice(dsp_active(), 0, "sine");
+        bench_voice(dsp_active(), 1, "saw");
+        bench_voice(dsp_active(), 2, "square");
+        bench_voice(dsp_active(), 3, "triangle");
+        bench_multirate(dsp_active(), 0, 130.8f, "sine 131 Hz");
+        bench_multirate(dsp_active(), 0, 440.0f, "sine 440 Hz");
+        bench_multirate(dsp_active(), 2, 65.4f,  "square 65 Hz");
+        bench_multirate(dsp_active(), 1, 130.8f, "saw 131 Hz");
+        bench_limiter(dsp_active());
+        bench_grains(dsp_active());
+        bench_pcm(dsp_active(), PCM_INT16, 2, DITHER_TPDF);
+        bench_pcm(dsp_active(), PCM_INT16, 2, DITHER_NONE);
+        bench_pcm(dsp_active(), PCM_INT24, 2, DITHER_SHAPED);
+        bench_pcm(dsp_active(), PCM_INT32, 1, DITHER_NONE);
+    }
+
+    std::cout << "[scalar]" << std::endl;
+    bench_string();
+
+    std::cout << "[graph, " << dsp_active()->isa << "]" << std::endl;
+    bench_graph(dsp_active(), 0);
+    int spare = std::min<int>(3, (int)std::thread::hardware_concurrency() - 1);
+    if (spare > 0)
+        bench_graph(dsp_active(), spare);
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include "control.h"
+
+#include <iostream>
+#include <sstream>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "trace.h"
+
+static void reply(control_socket *c, int i, const std::string &text) {
+    if (c->msgs[i].msg_hdr.msg_namelen <= sizeof(sa_family_t))
+        return;
+    sendto(c->fd, text.data(), text.size(), MSG_DONTWAIT,
+           (const sockaddr*)&c->senders[i], c->msgs[i].msg_hdr.msg_namelen);
+}
+
+// Passes the shared output ring to the sender.
+static bool share(control_socket *c, int i) {
+    if (c->share_fd == -1 || c->msgs[i].msg_hdr.msg_namelen <= sizeof(sa_family_t))
+        return false;
+
+    char text[] = "share\n";
+    iovec iov = {text, sizeof(text) - 1};
+    union {
+        cmsghdr header;
+        char    space[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name       = &c->senders[i];
+    msg.msg_namelen    = c->msgs[i].msg_hdr.msg_namelen;
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.space;
+    msg.msg_controllen = sizeof(control.space);
+
+    cmsghdr *cmsg    = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &c->share_fd, sizeof(int));
+    return sendmsg(c->fd, &msg, MSG_DONTWAIT) != -1;
+}
+
+static std::string stats(control_socket *c, pa_data *data) {
+    std::ostringstream out;
+    const patch *p = patch_acquire(&data->patches);
+    size_t queued = data->events.head.load() - data->events.tail.load();
+
+    out << "isa " << data->dsp->isa << "\n"
+        << "sample_rate " << SAMPLE_RATE << "\n"
+        << "event_queue " << queued << "\n"
+        << "messages " << c->messages << "\n"
+        << "batches " << c->batches << "\n"
+        << "dropped_notes " << c->dropped << "\n"
+        << "waveform " << p->waveform << "\n"
+        << "amplitude " << p->amplitude << "\n"
+        << "arp " << p->arp << "\n"
+        << "tempo " << p->tempo << "\n"
+        << "graph_nodes " << graph_acquire(&data->graphs)->nodes.size() << "\n"
+        << "graph_workers " << data->workers.threads.size() << "\n"
+        << "idle_seconds " << (double)data->idle.load(std::memory_order_relaxed) / SAMPLE_RATE << "\n";
+
+    limiter_stats limiter;
+    if (limiter_take_stats(&data->master, &limiter)) {
+        out << "limiter_blocks " << limiter.blocks << "\n"
+            << "limiter_avg_us " << limiter.avg_us << "\n"
+            << "limiter_max_us " << limiter.max_us << "\n"
+            << "limiter_reduction_db " << limiter.reduction_db << "\n";
+    }
+    return out.str();
+}
+
+// Everything after the last token taken from *state, trimmed; values such
+// as `lfo1 sine 5` span several words.
+static char *rest_of_line(char **state) {
+    char *rest = strtok_r(NULL, "", state);
+    if (rest == NULL)
+        return NULL;
+    rest += strspn(rest, " \t");
+    size_t length = strlen(rest);
+    while (length > 0 && strchr(" \t\r", rest[length - 1]) != NULL)
+        rest[--length] = '\0';
+    return length > 0 ? rest : NULL;
+}
+
+static bool parse_note(const char *text, int *note) {
+    if (text == NULL)
+        return false;
+    char *end;
+    long n = strtol(text, &end, 10);
+    *note = (int)n;
+    return *end == '\0' && n >= 0 && n < TUNING_NOTES;
+}
+
+bool control_open(control_socket *c, const char *path) {
+    c->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->fd == -1) {
+        std::cerr << "Error creating control socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        std::cerr << "Control socket path too long: " << path << std::endl;
+        close(c->fd);
+        c->fd = -1;
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+
+    unlink(path);
+    if (bind(c->fd, (const sockaddr*)&addr, sizeof(addr)) == -1) {
+        std::cerr << "Error binding control socket " << path << ": " << strerror(errno) << std::endl;
+        close(c->fd);
+        c->fd = -1;
+        return false;
+    }
+
+    c->path     = path;
+    c->messages = 0;
+    c->batches  = 0;
+    c->dropped  = 0;
+    c->share_fd = -1;
+    for (int i = 0; i < CONTROL_BATCH; i++) {
+        c->iov[i].iov_base = c->buffers[i];
+        c->iov[i].iov_len  = CONTROL_MESSAGE - 1;
+        memset(&c->msgs[i], 0, sizeof(c->msgs[i]));
+        c->msgs[i].msg_hdr.msg_iov    = &c->iov[i];
+        c->msgs[i].msg_hdr.msg_iovlen = 1;
+        c->msgs[i].msg_hdr.msg_name   = &c->senders[i];
+    }
+
+    std::cerr << "Control socket: " << path << std::endl;
+    return true;
+}
+
+bool control_poll(control_socket *c, pa_data *data) {
+    patch next = *patch_acquire(&data->patches);
+    bool changed = false;
+    bool running = true;
+    unsigned long dropped = 0;
+    int  count;
+
+    do {
+        for (int i = 0; i < CONTROL_BATCH; i++)
+            c->msgs[i].msg_hdr.msg_namelen = sizeof(c->senders[i]);
+
+        count = recvmmsg(c->fd, c->msgs, CONTROL_BATCH, MSG_DONTWAIT, NULL);
+        if (count <= 0)
+            break;
+        c->batches++;
+        c->messages += count;
+
+        for (int i = 0; i < count; i++) {
+            char *text = c->buffers[i];
+            text[c->msgs[i].msg_len] = '\0';
+
+            char *line_state;
+            for (char *line = strtok_r(text, "\n", &line_state); line != NULL;
+                 line = strtok_r(NULL, "\n", &line_state)) {
+                char *state;
+                char *command = strtok_r(line, " \t\r", &state);
+                char *arg1    = strtok_r(NULL, " \t\r", &state);
+                char *arg2    = rest_of_line(&state);
+                int   note;
+                bool  ok = true;
+
+                if (command == NULL) {
+                    continue;
+                } else if (strcmp(command, "on") == 0 || strcmp(command, "off") == 0) {
+                    ok = parse_note(arg1, &note) && data->keys.note_frequency[note] > 0.0f;
+                    if (ok && !synth_note(data, note, command[1] == 'n'))
+                        dropped++;
+                } else if (strcmp(command, "set") == 0) {
+                    ok = arg1 != NULL && arg2 != NULL && patch_set(&next, arg1, arg2);
+                    changed = changed || ok;
+                } else if (strcmp(command, "graph") == 0) {
+                    graph *g = NULL;
+                    ok = arg1 != NULL && graph_load(arg1, SAMPLE_RATE, ENGINE_BLOCK, &g);
+                    if (ok)
+                        graph_publish(&data->graphs, g);
+                } else if (strcmp(command, "stats") == 0) {
+                    reply(c, i, stats(c, data));
+                } else if (strcmp(command, "share") == 0) {
+                    ok = share(c, i);
+                } else if (strcmp(command, "trace") == 0) {
+                    ok = arg1 != NULL && trace_write(arg1);
+                } else if (strcmp(command, "quit") == 0) {
+                    running = false;
+                } else {
+                    ok = false;
+                }
+
+                if (!ok)
+                    reply(c, i, std::string("error ") + command + "\n");
+            }
+        }
+    } while (count == CONTROL_BATCH);
+
+    if (changed)
+        patch_publish(&data->patches, next);
+    if (dropped > 0) {
+        c->dropped += dropped;
+        std::cerr << "Control: event queue full, dropped " << dropped << " notes" << std::endl;
+    }
+    return running;
+}
+
+void control_close(control_socket *c) {
+    if (c->fd == -1)
+        return;
+    close(c->fd);
+    unlink(c->path.c_str());
+    c->fd = -1;
+}
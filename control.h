@@ -0,0 +1,51 @@
+#ifndef RASKOL_CONTROL_H
+#define RASKOL_CONTROL_H
+
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "synth.h"
+
+// Local control endpoint: a Unix datagram socket taking one or more
+// newline-separated text commands per datagram.
+//
+//   on <note>          MIDI note on, through the tuning
+//   off <note>
+//   set <key> <value>  any patch file key
+//   graph <path>       compiles a graph file and swaps it in
+//   stats              replies with engine telemetry
+//   share              replies with the shared output ring's fd (SCM_RIGHTS)
+//   trace <path>       writes the --trace timeline so far to path
+//   quit
+//
+// Datagrams are read in batches with recvmmsg(). Notes go to the audio
+// thread through the note event queue; the settings of a batch are
+// published as one new patch. Errors and stats are answered to the sender
+// when it has bound an address.
+
+const int    CONTROL_BATCH   = 64;
+const size_t CONTROL_MESSAGE = 1024;
+
+typedef struct {
+    int fd;
+    std::string path;
+    unsigned long messages;
+    unsigned long batches;
+    unsigned long dropped;      // notes refused by a full event queue
+    int share_fd;               // shared output ring, -1 if none
+    char buffers[CONTROL_BATCH][CONTROL_MESSAGE];
+    iovec iov[CONTROL_BATCH];
+    mmsghdr msgs[CONTROL_BATCH];
+    sockaddr_un senders[CONTROL_BATCH];
+}
+control_socket;
+
+bool control_open(control_socket *c, const char *path);
+
+// Control thread: handles every queued datagram. Returns false on quit.
+bool control_poll(control_socket *c, pa_data *data);
+
+void control_close(control_socket *c);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef RASKOL_EVENT_QUEUE_H
+#define RASKOL_EVENT_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// Single-producer single-consumer ring carrying note events from the
+// control thread to the audio thread. Neither side allocates or blocks.
+
+const int NOTE_ON  = 1;
+const int NOTE_OFF = 0;
+
+const size_t EVENT_QUEUE_SIZE = 1024;   // power of two
+
+typedef struct {
+    int   type;
+    int   key;
+    float frequency;
+    float phase_increment;
+}
+note_event;
+
+typedef struct {
+    note_event events[EVENT_QUEUE_SIZE];
+    alignas(64) std::atomic<size_t> head;   // next slot the producer writes
+    alignas(64) std::atomic<size_t> tail;   // next slot the consumer reads
+}
+event_queue;
+
+inline void event_queue_init(event_queue *q) {
+    q->head.store(0);
+    q->tail.store(0);
+}
+
+inline bool event_queue_push(event_queue *q, const note_event &e) {
+    size_t head = q->head.load(std::memory_order_relaxed);
+    if (head - q->tail.load(std::memory_order_acquire) == EVENT_QUEUE_SIZE)
+        return false;
+    q->events[head & (EVENT_QUEUE_SIZE - 1)] = e;
+    q->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+inline bool event_queue_pop(event_queue *q, note_event *e) {
+    size_t tail = q->tail.load(std::memory_order_relaxed);
+    if (tail == q->head.load(std::memory_order_acquire))
+        return false;
+    *e = q->events[tail & (EVENT_QUEUE_SIZE - 1)];
+    q->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+// Producer side: true while events wait for the consumer.
+inline bool event_queue_pending(const event_queue *q) {
+    return q->head.load(std::memory_order_relaxed) != q->tail.load(std::memory_order_acquire);
+}
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef RASKOL_FAST_MATH_H
+#define RASKOL_FAST_MATH_H
+
+#include <cstdint>
+
+// Float approximations of the transcendental functions the audio path
+// needs, accurate to about the float rounding of their result rather than
+// libm's last bit. They are branch-free and static, so loops over them
+// vectorise and every kernel variant compiles its own copy; the kernels
+// also apply them to whole blocks (dsp_kernels::sin_block and the like).
+//
+// The bounds below are against double libm and are checked by `mathcheck`
+// on every ISA. NaN and infinities are not handled.
+
+// Absolute error for |x| <= 2 pi. The argument is reduced in float, which
+// costs about |x| * 6e-8; the polynomial itself is good to 1e-7.
+const float FAST_SIN_MAX_ERROR  = 5e-7f;
+
+// Relative error for x in [-126, 127]. Past that, up to |x| = 2^22, the
+// result saturates at about 2^-126 and 2^127.
+const float FAST_EXP2_MAX_ERROR = 2.5e-7f;
+
+// Absolute error while |log2(x)| <= 1, relative past that.
+const float FAST_LOG2_MAX_ERROR = 2.5e-7f;
+
+// Absolute error for |x| <= 1e6.
+const float FAST_TANH_MAX_ERROR = 2.5e-7f;
+
+// Relative error for x in [1e-3, 1e3] and |y| <= 4; it grows with
+// |y * log2(x)|.
+const float FAST_POW_MAX_ERROR  = 4e-6f;
+
+static const float FAST_TWO_PI     = 6.28318530717958647692f;
+static const float FAST_INV_TWO_PI = 0.15915494309189533577f;
+
+static inline float fast_bits_float(int32_t i) {
+    float f;
+    __builtin_memcpy(&f, &i, sizeof(f));
+    return f;
+}
+
+static inline int32_t fast_float_bits(float f) {
+    int32_t i;
+    __builtin_memcpy(&i, &f, sizeof(i));
+    return i;
+}
+
+// Reduce to a fraction of a turn, fold into a quarter period and evaluate
+// an odd Taylor polynomial of degree 11.
+static inline float fast_sin(float x) {
+    float t = x * FAST_INV_TWO_PI;
+    t -= (float)(int)t;
+    t += t < 0.0f ? 1.0f : 0.0f;
+    float s = t - 0.5f;                 // sin(2 pi t) = -sin(2 pi s)
+    float a = __builtin_fabsf(s);
+    float b = 0.5f - a;
+    float m = a < b ? a : b;            // sin(2 pi a) = sin(2 pi (0.5 - a))
+    float z  = m * FAST_TWO_PI;
+    float z2 = z * z;
+    float p  = -1.0f / 39916800.0f;
+    p = p * z2 + 1.0f / 362880.0f;
+    p = p * z2 - 1.0f / 5040.0f;
+    p = p * z2 + 1.0f / 120.0f;
+    p = p * z2 - 1.0f / 6.0f;
+    p = p * z2 + 1.0f;
+    float r = z * p;
+    return s < 0.0f ? r : -r;
+}
+
+// sin(2 pi t) for t >= 0 in turns. t is reduced to [0, 1) before it is
+// scaled, so harmonics k * t of a phase stay in fast_sin's domain.
+static inline float fast_sin_turns(float t) {
+    return fast_sin((t - (float)(int)t) * FAST_TWO_PI);
+}
+
+// 2^round(x) from the exponent bits times a degree 6 polynomial for the
+// remaining [-1/2, 1/2] (Chebyshev fit, 2.5e-9). Rounding adds 1.5 * 2^23
+// so the integer lands in the low mantissa bits, and the exponent is
+// clamped as an integer: GCC does not vectorise a float clamp or float to
+// int conversion here under the default -ftrapping-math.
+static inline float fast_exp2(float x) {
+    float   k = x + 12582912.0f;
+    int32_t n = fast_float_bits(k) - 0x4b400000;
+    float   f = x - (k - 12582912.0f);
+    n = n < -126 ? -126 : n;
+    n = n > 127 ? 127 : n;
+    float p = 1.5461444698004702e-4f;
+    p = p * f + 1.340042817764369e-3f;
+    p = p * f + 9.61805667852822e-3f;
+    p = p * f + 5.5503272266701556e-2f;
+    p = p * f + 2.4022650922288716e-1f;
+    p = p * f + 6.931472067028328e-1f;
+    p = p * f + 1.0f;
+    return p * fast_bits_float((n + 127) << 23);
+}
+
+// x > 0 and normal. The mantissa is taken to [sqrt(1/2), sqrt(2)) and
+// log(m) = 2 atanh((m - 1) / (m + 1)) is summed to the s^9 term.
+static inline float fast_log2(float x) {
+    int32_t bits = fast_float_bits(x);
+    int32_t mant = bits & 0x007fffff;
+    int32_t high = mant > 0x003504f3 ? 1 : 0;       // mantissa of sqrt(2)
+    int32_t e    = ((bits >> 23) & 0xff) - 127 + high;
+    float   m    = fast_bits_float(mant | (0x3f800000 - (high << 23)));
+    float s  = (m - 1.0f) / (m + 1.0f);
+    float s2 = s * s;
+    float p  = 1.0f / 9.0f;
+    p = p * s2 + 1.0f / 7.0f;
+    p = p * s2 + 1.0f / 5.0f;
+    p = p * s2 + 1.0f / 3.0f;
+    p = p * s2 + 1.0f;
+    return (float)e + s * p * 2.88539008177792681f;     // 2 / ln 2
+}
+
+// (e^2x - 1) / (e^2x + 1); fast_exp2 saturating makes it exactly +-1
+// past |x| = 9 or so.
+static inline float fast_tanh(float x) {
+    float e = fast_exp2(x * 2.88539008177792681f);
+    return (e - 1.0f) / (e + 1.0f);
+}
+
+// x^y for x > 0.
+static inline float fast_pow(float x, float y) {
+    return fast_exp2(y * fast_log2(x));
+}
+
+#endif
@@ -0,0 +1,360 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "audio_guard.h"
+#include "synth.h"
+
+// Renders scripted note timelines through every render kernel and compares
+// them with the reference renders stored in golden/. Dispatched kernels are
+// checked once per ISA variant the CPU can run. `golden --update` rewrites
+// the references from the scalar kernel. Timelines with their own signal
+// graph render it on worker threads, so the parallel schedule has to give
+// the same output as running it in order.
+
+const unsigned long TIMELINE_FRAMES = 8192;
+const unsigned long BLOCK           = 256;
+const int GOLDEN_WORKERS            = 2;
+
+typedef struct {
+    unsigned long frame;
+    int code;
+    int value;
+}
+scripted_event;
+
+typedef struct {
+    const char *name;
+    const scripted_event *events;
+    size_t count;
+    void (*setup)(patch *p);        // initial patch; NULL keeps the defaults
+    const char *graph;              // NULL keeps the default graph
+}
+timeline;
+
+static const scripted_event SINGLE_SINE[] = {
+    {0, KEY_X, 1}, {0, KEY_Y, 1}, {4096, KEY_Y, 0}
+};
+
+static const scripted_event CHORD_SQUARE[] = {
+    {0, KEY_V, 1}, {0, KEY_A, 1}, {100, KEY_G, 1}, {200, KEY_K, 1},
+    {3000, KEY_G, 0}, {5000, KEY_A, 0}, {6000, KEY_K, 0}
+};
+
+static const scripted_event WAVEFORM_SWITCH[] = {
+    {0, KEY_Q, 1}, {0, KEY_T, 1},
+    {1024, KEY_X, 1}, {2048, KEY_C, 1}, {3072, KEY_V, 1}, {4096, KEY_B, 1},
+    {6000, KEY_Q, 0}, {7000, KEY_T, 0}
+};
+
+// Fast ratcheting arpeggio with swing; its notes fall inside render blocks.
+static const scripted_event ARPEGGIO[] = {
+    {0, KEY_A, 1}, {0, KEY_F, 1}, {0, KEY_J, 1}, {5000, KEY_F, 0}, {7000, KEY_A, 0}, {7000, KEY_J, 0}
+};
+
+static void arpeggio_patch(patch *p) {
+    p->waveform = 1;
+    p->arp      = ARP_UPDOWN;
+    p->tempo    = 300.0f;
+    p->division = 4;
+    p->swing    = 0.3f;
+    p->gate     = 0.6f;
+    p->octaves  = 2;
+    p->steps    = 4;
+    p->ratchets[0] = 1;
+    p->ratchets[1] = 3;
+    p->ratchets[2] = 0;
+    p->ratchets[3] = 2;
+}
+
+// Vibrato, sample-and-hold tremolo and an envelope pitch drop, with notes
+// starting between control points.
+static const scripted_event MODULATED[] = {
+    {0, KEY_A, 1}, {700, KEY_G, 1}, {2500, KEY_K, 1}, {4000, KEY_A, 0}, {6100, KEY_G, 0}, {7000, KEY_K, 0}
+};
+
+static void modulated_patch(patch *p) {
+    p->waveform     = 3;
+    p->lfo_shape[0] = LFO_SINE;
+    p->lfo_rate[0]  = 6.0f;
+    p->lfo_shape[1] = LFO_RANDOM;
+    p->lfo_rate[1]  = 40.0f;
+    p->mod_attack   = 0.0f;
+    p->mod_decay    = 0.05f;
+    p->routes[0]    = {MOD_LFO1, MOD_PITCH, 0.5f};
+    p->routes[1]    = {MOD_LFO2, MOD_AMP, 0.4f};
+    p->routes[2]    = {MOD_ENV, MOD_PITCH, 12.0f};
+    p->control_period = 24;
+}
+
+// A dense cloud over the live output of a chord; grains overlap block
+// boundaries and the pool stays busy.
+static const scripted_event GRAINS[] = {
+    {0, KEY_A, 1}, {0, KEY_G, 1}, {300, KEY_K, 1}, {5000, KEY_G, 0}, {6500, KEY_A, 0}, {7000, KEY_K, 0}
+};
+
+static void grains_patch(patch *p) {
+    p->waveform       = 1;
+    p->grains         = 800.0f;
+    p->grain_size     = 0.03f;
+    p->grain_window   = GRAIN_TUKEY;
+    p->grain_position = 0.02f;
+    p->grain_spread   = 0.01f;
+    p->grain_pitch    = 7.0f;
+    p->grain_jitter   = 0.2f;
+    p->grain_mix      = 0.5f;
+}
+
+// Plucked strings from low to high, overlapping, then a struck string
+// with vibrato retuning its delay line at every control point.
+static const scripted_event PLUCKED[] = {
+    {0, KEY_A, 1}, {500, KEY_G, 1}, {1200, KEY_RIGHTBRACE, 1}, {4000, KEY_A, 0}, {6000, KEY_G, 0},
+    {7000, KEY_RIGHTBRACE, 0}
+};
+
+static void string_pluck_patch(patch *p) {
+    p->waveform          = WAVEFORM_STRING;
+    p->string_decay      = 1.5f;
+    p->string_brightness = 0.7f;
+}
+
+static const scripted_event STRUCK[] = {
+    {0, KEY_Q, 1}, {900, KEY_T, 1}, {5000, KEY_Q, 0}, {7500, KEY_T, 0}
+};
+
+static void string_strike_patch(patch *p) {
+    p->waveform       = WAVEFORM_STRING;
+    p->string_excite  = STRING_STRIKE;
+    p->string_decay   = 4.0f;
+    p->lfo_rate[0]    = 7.0f;
+    p->routes[0]      = {MOD_LFO1, MOD_PITCH, 0.4f};
+}
+
+// A saw chord and a drone through two filters, each into its own feedback
+// delay, mixed on a bus; the filters and the delays run in parallel.
+static const scripted_event EFFECTS[] = {
+    {0, KEY_C, 1}, {0, KEY_A, 1}, {0, KEY_G, 1}, {2000, KEY_K, 1}, {4000, KEY_A, 0}, {5000, KEY_G, 0},
+    {6000, KEY_K, 0}
+};
+
+static const char EFFECTS_GRAPH[] =
+    "voices voices\n"
+    "drone  osc    waveform=triangle freq=110 level=0.3\n"
+    "low    filter voices drone mode=lowpass cutoff=900 q=2\n"
+    "high   filter voices mode=highpass cutoff=3000\n"
+    "echo   delay  low time=0.021 feedback=0.6\n"
+    "room   delay  high time=0.013 feedback=0.3\n"
+    "out    bus    voices*0.5 echo*0.4 room*0.3 drone*0.2\n";
+
+static const int LAYOUT_KEYS[] = {
+    KEY_A, KEY_S, KEY_D, KEY_F, KEY_G, KEY_H, KEY_J, KEY_K, KEY_L, KEY_SEMICOLON,
+    KEY_APOSTROPHE, KEY_BACKSLASH, KEY_Q, KEY_2, KEY_W, KEY_3, KEY_E, KEY_R, KEY_5,
+    KEY_T, KEY_6, KEY_Y, KEY_7, KEY_U, KEY_I, KEY_9, KEY_O, KEY_0, KEY_P,
+    KEY_LEFTBRACE, KEY_EQUAL, KEY_RIGHTBRACE
+};
+
+static const int LAYOUT_KEY_COUNT = sizeof(LAYOUT_KEYS) / sizeof(LAYOUT_KEYS[0]);
+
+// Every key, staggered, then released in reverse.
+static std::vector<scripted_event> full_polyphony() {
+    std::vector<scripted_event> events;
+    scripted_event saw = {0, KEY_C, 1};
+    events.push_back(saw);
+    for (int i = 0; i < LAYOUT_KEY_COUNT; i++) {
+        scripted_event e = {(unsigned long)i * 64, LAYOUT_KEYS[i], 1};
+        events.push_back(e);
+    }
+    for (int i = LAYOUT_KEY_COUNT - 1; i >= 0; i--) {
+        scripted_event e = {4096 + (unsigned long)(LAYOUT_KEY_COUNT - 1 - i) * 96, LAYOUT_KEYS[i], 0};
+        events.push_back(e);
+    }
+    return events;
+}
+
+static void render_timeline(const timeline &t, const render_kernel *kernel, const dsp_kernels *dsp,
+                            std::vector<float> *out) {
+    scale s;
+    keyboard_map m;
+    patch initial;
+    scale_builtin("12tet", &s);
+    keyboard_map_defaults(&m);
+    patch_defaults(&initial);
+    if (t.setup != NULL)
+        t.setup(&initial);
+
+    pa_data data;
+    synth_init(&data, s, m, initial);
+    data.kernel = kernel;
+    data.dsp    = dsp;
+    if (t.graph != NULL) {
+        graph *g = NULL;
+        if (graph_compile(t.graph, t.name, SAMPLE_RATE, ENGINE_BLOCK, &g))
+            graph_publish(&data.graphs, g);
+        graph_workers_start(&data.workers, GOLDEN_WORKERS, &data.rt);
+    }
+
+    out->assign(TIMELINE_FRAMES, 0.0f);
+    unsigned long rendered = 0;
+    size_t next = 0;
+
+    while (rendered < TIMELINE_FRAMES) {
+        while (next < t.count && t.events[next].frame <= rendered) {
+            input_event event;
+            memset(&event, 0, sizeof(event));
+            event.type  = EV_KEY;
+            event.code  = t.events[next].code;
+            event.value = t.events[next].value;
+            synth_input(&data, event);
+            patch_collect(&data.patches);
+            graph_collect(&data.graphs);
+            next++;
+        }
+
+        unsigned long until = next < t.count ? t.events[next].frame : TIMELINE_FRAMES;
+        unsigned long frames = std::min(std::min(until, TIMELINE_FRAMES) - rendered, BLOCK);
+        synth_render(&data, out->data() + rendered, frames);
+        rendered += frames;
+    }
+
+    synth_free(&data);
+}
+
+static std::string golden_path(const char *dir, const timeline &t) {
+    return std::string(dir) + "/" + t.name + ".f32";
+}
+
+static bool load_golden(const std::string &path, std::vector<float> *samples) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+    samples->assign(TIMELINE_FRAMES, 0.0f);
+    file.read((char*)samples->data(), TIMELINE_FRAMES * sizeof(float));
+    return (unsigned long)file.gcount() == TIMELINE_FRAMES * sizeof(float);
+}
+
+static bool save_golden(const std::string &path, const std::vector<float> &samples) {
+    std::ofstream file(path.c_str(), std::ios::binary);
+    file.write((const char*)samples.data(), samples.size() * sizeof(float));
+    return (bool)file;
+}
+
+static bool compare(const timeline &t, const render_kernel *kernel, const dsp_kernels *dsp,
+                    const std::vector<float> &reference, const std::vector<float> &output) {
+    double max_error = 0.0;
+    double signal    = 0.0;
+    double noise     = 0.0;
+    bool   exact     = true;
+
+    for (unsigned long i = 0; i < TIMELINE_FRAMES; i++) {
+        double diff = (double)output[i] - reference[i];
+        if (memcmp(&output[i], &reference[i], sizeof(float)) != 0)
+            exact = false;
+        max_error = std::max(max_error, std::fabs(diff));
+        signal += (double)reference[i] * reference[i];
+        noise  += diff * diff;
+    }
+
+    bool ok = kernel->max_error == 0.0f ? exact : max_error <= kernel->max_error;
+
+    std::string name = kernel->name;
+    if (kernel->dispatched)
+        name += std::string("/") + dsp->isa;
+
+    std::cout << std::left << std::setw(20) << t.name << std::setw(14) << name
+              << " max error " << std::scientific << std::setprecision(3) << max_error << "  SNR ";
+    if (noise == 0.0)
+        std::cout << "     inf";
+    else
+        std::cout << std::fixed << std::setprecision(1) << std::setw(8) << 10.0 * log10(signal / noise);
+    std::cout << " dB  " << (ok ? "ok" : "FAIL") << std::endl;
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const char *dir = RASKOL_GOLDEN_DIR;
+    bool update = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--update] [--dir golden]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::vector<scripted_event> polyphony = full_polyphony();
+    const timeline timelines[] = {
+        {"single_sine",     SINGLE_SINE,      sizeof(SINGLE_SINE) / sizeof(SINGLE_SINE[0]),         NULL,                NULL},
+        {"chord_square",    CHORD_SQUARE,     sizeof(CHORD_SQUARE) / sizeof(CHORD_SQUARE[0]),       NULL,                NULL},
+        {"waveform_switch", WAVEFORM_SWITCH,  sizeof(WAVEFORM_SWITCH) / sizeof(WAVEFORM_SWITCH[0]), NULL,                NULL},
+        {"full_polyphony",  polyphony.data(), polyphony.size(),                                     NULL,                NULL},
+        {"arpeggio",        ARPEGGIO,         sizeof(ARPEGGIO) / sizeof(ARPEGGIO[0]),               arpeggio_patch,      NULL},
+        {"modulated",       MODULATED,        sizeof(MODULATED) / sizeof(MODULATED[0]),             modulated_patch,     NULL},
+        {"grains",          GRAINS,           sizeof(GRAINS) / sizeof(GRAINS[0]),                   grains_patch,        NULL},
+        {"string_pluck",    PLUCKED,          sizeof(PLUCKED) / sizeof(PLUCKED[0]),                 string_pluck_patch,  NULL},
+        {"string_strike",   STRUCK,           sizeof(STRUCK) / sizeof(STRUCK[0]),                   string_strike_patch, NULL},
+        {"effects",         EFFECTS,          sizeof(EFFECTS) / sizeof(EFFECTS[0]),                 NULL,                EFFECTS_GRAPH}
+    };
+
+    audio_guard_init();
+    audio_guard_set_fatal(false);
+
+    // Undispatched kernels still run the master limiter; the baseline ISA
+    // keeps their output identical on every host.
+    const dsp_kernels *baseline = dsp_find(DSP_ISAS[0]);
+
+    bool ok = true;
+    std::vector<float> reference;
+    std::vector<float> output;
+
+    for (size_t i = 0; i < sizeof(timelines) / sizeof(timelines[0]); i++) {
+        const timeline &t = timelines[i];
+        std::string path = golden_path(dir, t);
+
+        if (update) {
+            render_timeline(t, synth_find_kernel("scalar"), baseline, &reference);
+            if (!save_golden(path, reference)) {
+                std::cerr << "Error writing " << path << std::endl;
+                return 1;
+            }
+            std::cout << "Wrote " << path << std::endl;
+            continue;
+        }
+
+        if (!load_golden(path, &reference)) {
+            std::cerr << "Missing or short reference " << path << " (run with --update)" << std::endl;
+            ok = false;
+            continue;
+        }
+
+        for (int k = 0; k < RENDER_KERNEL_COUNT; k++) {
+            const render_kernel *kernel = &RENDER_KERNELS[k];
+            for (int i = 0; i < DSP_ISA_COUNT; i++) {
+                const dsp_kernels *dsp = kernel->dispatched ? dsp_find(DSP_ISAS[i]) : baseline;
+                if (dsp == NULL)
+                    continue;
+
+                audio_guard_reset();
+                render_timeline(t, kernel, dsp, &output);
+                ok = compare(t, kernel, dsp, reference, output) && ok;
+
+                if (audio_guard_allocations() != 0 || audio_guard_syscalls() != 0) {
+                    std::cout << "  " << audio_guard_allocations() << " allocations, "
+                              << audio_guard_syscalls() << " blocking calls on the audio path" << std::endl;
+                    ok = false;
+                }
+                if (!kernel->dispatched)
+                    break;
+            }
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+#include "grains.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "fast_math.h"
+
+static void fill_windows(granular *g) {
+    for (int i = 0; i <= GRAIN_WINDOW; i++) {
+        double x = (double)i / GRAIN_WINDOW;            // 0-1 across the grain
+        double hann  = 0.5 - 0.5 * std::cos(2.0 * M_PI * x);
+        double d     = (x - 0.5) / 0.18;
+        double gauss = std::exp(-0.5 * d * d);
+        double edge  = std::min(x, 1.0 - x) / 0.15;      // flat top, cosine edges
+        double tukey = edge >= 1.0 ? 1.0 : 0.5 - 0.5 * std::cos(M_PI * edge);
+
+        g->windows[GRAIN_HANN][i]     = (float)hann;
+        g->windows[GRAIN_GAUSS][i]    = (float)gauss;
+        g->windows[GRAIN_TUKEY][i]    = (float)tukey;
+        g->windows[GRAIN_TRIANGLE][i] = (float)(1.0 - std::fabs(2.0 * x - 1.0));
+    }
+}
+
+void grains_init(granular *g) {
+    g->source.assign(GRAIN_SOURCE, 0.0f);
+    g->mask        = GRAIN_SOURCE - 1;
+    g->loaded      = 0;
+    g->source_rate = 1.0f;
+    g->written     = 0;
+    g->active      = 0;
+    g->next_spawn  = 0.0;
+    g->random      = 0x6c8e9cf5u;
+    g->dropped.store(0, std::memory_order_relaxed);
+    fill_windows(g);
+}
+
+void grains_load(granular *g, const std::vector<float> &samples, int sample_rate, int engine_rate) {
+    size_t size = 1;
+    while (size < samples.size() + 1)
+        size <<= 1;
+    // Reads past the end land in silence rather than the sample's start.
+    g->source.assign(size * 2, 0.0f);
+    std::copy(samples.begin(), samples.end(), g->source.begin());
+    g->mask        = (unsigned)(size * 2 - 1);
+    g->loaded      = samples.size();
+    g->source_rate = (float)sample_rate / engine_rate;
+}
+
+// Uniform in [-1, 1).
+static float next_random(granular *g) {
+    g->random ^= g->random << 13;
+    g->random ^= g->random >> 17;
+    g->random ^= g->random << 5;
+    return (float)(g->random >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+static void spawn(granular *g, const patch *p, const float *pitches, int count, int sample_rate,
+                  uint32_t delay) {
+    if (g->active == GRAIN_POOL) {
+        g->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint32_t length = std::max<uint32_t>(16, (uint32_t)(p->grain_size * sample_rate));
+    float voice     = pitches[(g->random >> 3) % (uint32_t)count];
+    float semitones = p->grain_pitch + p->grain_jitter * next_random(g);
+    float rate      = voice / GRAIN_ROOT * fast_exp2(semitones * (1.0f / 12.0f)) * g->source_rate;
+    double offset   = (p->grain_position + p->grain_spread * next_random(g)) * sample_rate;
+
+    double position;
+    if (g->loaded > 0) {
+        position = std::min(std::max(offset * g->source_rate, 0.0), (double)(g->loaded - 1));
+    } else {
+        // Far enough back that the grain never overtakes the write head, and
+        // recent enough that it is not overwritten before it ends.
+        double newest = length * (double)rate + 2.0;
+        double oldest = (double)(GRAIN_SOURCE - length - 2 * GRAIN_BLOCK);
+        double back   = std::min(std::max(offset, newest), oldest);
+        position = (double)(g->written + delay) - back;
+    }
+
+    grain &n    = g->pool[g->active++];
+    n.position  = position;
+    n.rate      = rate;
+    n.w         = 0.0f;
+    n.dw        = (float)GRAIN_WINDOW / length;
+    n.gain      = 1.0f / std::sqrt(std::max(1.0f, p->grains * p->grain_size));
+    n.delay     = delay;
+    n.remaining = length;
+}
+
+static void process_block(granular *g, const dsp_kernels *k, const patch *p, const float *pitches, int count,
+                          int sample_rate, float level, float *out, unsigned long n) {
+    if (g->loaded == 0) {
+        size_t offset = g->written & g->mask;
+        size_t first  = std::min<size_t>(n, g->mask + 1 - offset);
+        std::copy(out, out + first, g->source.begin() + offset);
+        std::copy(out + first, out + n, g->source.begin());
+    }
+
+    // Asynchronous cloud: intervals vary by +-50% around the mean.
+    double interval = sample_rate / p->grains;
+    while (g->next_spawn < n) {
+        if (count > 0)
+            spawn(g, p, pitches, count, sample_rate, (uint32_t)std::max(0.0, g->next_spawn));
+        g->next_spawn += interval * (1.0 + 0.5 * next_random(g));
+    }
+    g->next_spawn -= n;
+
+    std::fill(g->cloud, g->cloud + n, 0.0f);
+    const float *window = g->windows[p->grain_window];
+    for (int i = 0; i < g->active; ) {
+        grain &e = g->pool[i];
+        unsigned long start = e.delay;
+        unsigned long len   = std::min<unsigned long>(e.remaining, n - start);
+
+        double base = std::floor(e.position);
+        k->grain(g->source.data(), g->mask, (unsigned)(int64_t)base, (float)(e.position - base), e.rate,
+                 window, e.w, e.dw, e.gain, g->cloud + start, len);
+
+        e.position  += (double)e.rate * len;
+        e.w         += e.dw * len;
+        e.remaining -= len;
+        e.delay      = 0;
+        if (e.remaining == 0)
+            e = g->pool[--g->active];
+        else
+            i++;
+    }
+
+    float dry = 1.0f - p->grain_mix;
+    float wet = p->grain_mix * level;
+    for (unsigned long i = 0; i < n; i++)
+        out[i] = out[i] * dry + g->cloud[i] * wet;
+
+    g->written += n;
+}
+
+void grains_process(granular *g, const dsp_kernels *k, const patch *p, const float *pitches, int count,
+                    int sample_rate, float level, float *out, unsigned long n) {
+    while (n > 0) {
+        unsigned long block = std::min(n, GRAIN_BLOCK);
+        process_block(g, k, p, pitches, count, sample_rate, level, out, block);
+        out += block;
+        n   -= block;
+    }
+}
+
+void grains_silence(granular *g, unsigned long n) {
+    if (g->loaded == 0) {
+        size_t offset = g->written & g->mask;
+        size_t first  = std::min<size_t>(n, g->mask + 1 - offset);
+        std::fill(g->source.begin() + offset, g->source.begin() + offset + first, 0.0f);
+        std::fill(g->source.begin(), g->source.begin() + (n - first), 0.0f);
+    }
+    g->written += n;
+}
@@ -0,0 +1,66 @@
+#ifndef RASKOL_GRAINS_H
+#define RASKOL_GRAINS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "kernels.h"
+#include "patch.h"
+
+// Granular cloud mixed over the voices. Grains are short windowed reads
+// from a source: by default the engine's own output of the last few
+// seconds, or a loaded sample. They are pitched from the playing voices,
+// come from a fixed pool, and use precomputed window tables. Each one is
+// rendered a block at a time by the dispatched grain kernel.
+
+const size_t GRAIN_SOURCE  = 1 << 17;     // live history, samples (~3 s)
+const int    GRAIN_POOL    = 1024;
+const int    GRAIN_WINDOW  = 1024;        // table size, plus one guard entry
+const unsigned long GRAIN_BLOCK = 256;
+const float  GRAIN_ROOT    = 261.6256f;   // key that plays the source at its own pitch (C4)
+
+typedef struct {
+    double   position;          // source sample under the next output sample
+    float    rate;              // source samples per output sample
+    float    w;                 // window table position
+    float    dw;
+    float    gain;
+    uint32_t delay;             // samples into the next block before it starts
+    uint32_t remaining;         // output samples left
+}
+grain;
+
+typedef struct {
+    std::vector<float> source;  // power-of-two ring
+    unsigned mask;
+    size_t   loaded;            // length of a loaded sample; 0 records the output
+    float    source_rate;       // loaded sample rate / engine rate
+    uint64_t written;           // output samples recorded
+    grain    pool[GRAIN_POOL];
+    int      active;
+    double   next_spawn;        // samples from the block start
+    uint32_t random;
+    std::atomic<unsigned long> dropped;   // grains refused by a full pool, read by the control thread
+    float    cloud[GRAIN_BLOCK];
+    float    windows[GRAIN_WINDOWS][GRAIN_WINDOW + 1];
+}
+granular;
+
+void grains_init(granular *g);
+
+// Replaces the live history with a sample. Call before the stream starts.
+void grains_load(granular *g, const std::vector<float> &samples, int sample_rate, int engine_rate);
+
+// Audio thread: records `out` as source history if live, then mixes the
+// cloud into it. `pitches` holds the frequencies of the playing voices;
+// grains only start while there is at least one.
+void grains_process(granular *g, const dsp_kernels *k, const patch *p, const float *pitches, int count,
+                    int sample_rate, float level, float *out, unsigned long n);
+
+// Audio thread: records n samples of silence while the engine is idle and
+// the cloud is empty. Once the whole history is silent it can stop.
+void grains_silence(granular *g, unsigned long n);
+
+#endif
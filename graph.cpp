@@ -0,0 +1,569 @@
+#include "graph.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "trace.h"
+
+static const char *KIND_NAMES[] = {"voices", "grains", "osc", "filter", "delay", "bus"};
+
+// Trace spans per kind; the engine's own spans nest inside the first two.
+static const char *SPAN_NAMES[] = {"render", "cloud", "osc", "filter", "delay", "bus"};
+
+static const char *WAVEFORM_NAMES[] = {"sine", "saw", "square", "triangle"};
+
+static const char *FILTER_NAMES[] = {"lowpass", "highpass", "bandpass"};
+
+static bool parse_name(const std::string &value, const char *const *names, int count, int *out) {
+    for (int i = 0; i < count; i++) {
+        if (value == names[i]) {
+            *out = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_float(const std::string &value, float min, float max, float *out) {
+    char *end;
+    float f = strtof(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || !(f >= min && f <= max))
+        return false;
+    *out = f;
+    return true;
+}
+
+static bool valid_name(const std::string &name) {
+    for (size_t i = 0; i < name.size(); i++) {
+        char c = name[i];
+        if (!(isalnum((unsigned char)c) || c == '_'))
+            return false;
+    }
+    return !name.empty();
+}
+
+static void node_defaults(graph_node *n) {
+    n->input_count = 0;
+    n->level       = 0;
+    n->out         = NULL;
+    n->gain        = 1.0f;
+    n->mode        = 0;
+    n->phase       = 0.0f;
+    n->increment   = 0.0f;
+    n->k = n->a1 = n->a2 = n->a3 = 0.0f;
+    n->ic1 = n->ic2 = 0.0f;
+    n->write       = 0;
+    n->feedback    = 0.0f;
+}
+
+// Node parameters, checked against its kind; values not given keep these.
+typedef struct {
+    int   mode;
+    float frequency;
+    float q;
+    float time;
+    float feedback;
+}
+node_settings;
+
+static bool set_param(graph_node *n, node_settings *s, const std::string &key, const std::string &value) {
+    if (key == "level")
+        return parse_float(value, 0.0f, 16.0f, &n->gain);
+    switch (n->kind) {
+        case NODE_OSC:
+            if (key == "waveform")
+                return parse_name(value, WAVEFORM_NAMES, 4, &s->mode);
+            if (key == "freq")
+                return parse_float(value, 0.0f, 20000.0f, &s->frequency);
+            return false;
+        case NODE_FILTER:
+            if (key == "mode")
+                return parse_name(value, FILTER_NAMES, 3, &s->mode);
+            if (key == "cutoff")
+                return parse_float(value, 10.0f, 20000.0f, &s->frequency);
+            if (key == "q")
+                return parse_float(value, 0.1f, 40.0f, &s->q);
+            return false;
+        case NODE_DELAY:
+            if (key == "time")
+                return parse_float(value, 0.001f, GRAPH_MAX_DELAY, &s->time);
+            if (key == "feedback")
+                return parse_float(value, 0.0f, 0.99f, &s->feedback);
+            return false;
+        default:
+            return false;
+    }
+}
+
+// Coefficients and preallocated state from the settings.
+static void prepare(graph_node *n, const node_settings &s, int sample_rate) {
+    n->mode = s.mode;
+    if (n->kind == NODE_OSC) {
+        n->increment = (float)(2.0 * M_PI * s.frequency / sample_rate);
+    } else if (n->kind == NODE_FILTER) {
+        // Trapezoidal state-variable filter; stable at any cutoff below
+        // Nyquist, which the cutoff is clamped under.
+        double g = std::tan(M_PI * std::min(s.frequency, 0.49f * sample_rate) / sample_rate);
+        double k = 1.0 / s.q;
+        double a1 = 1.0 / (1.0 + g * (g + k));
+        n->k  = (float)k;
+        n->a1 = (float)a1;
+        n->a2 = (float)(g * a1);
+        n->a3 = (float)(g * g * a1);
+    } else if (n->kind == NODE_DELAY) {
+        n->line.assign(std::max<size_t>(1, (size_t)std::lround(s.time * sample_rate)), 0.0f);
+        n->feedback = s.feedback;
+    }
+}
+
+// Samples for the node's state to decay once its input is silent: a delay
+// line's length, or a filter's ring down to -100 dB.
+static unsigned long settle_time(const graph_node &n, const node_settings &s, int sample_rate) {
+    if (n.kind == NODE_DELAY)
+        return n.line.size();
+    if (n.kind != NODE_FILTER)
+        return 0;
+    double cutoff = std::max(1.0f, std::min(s.frequency, 0.49f * sample_rate));
+    return (unsigned long)std::ceil(std::log(1e5) * s.q / (M_PI * cutoff) * sample_rate);
+}
+
+// Kahn's algorithm, one level at a time, keeping spec order within a level.
+static bool schedule(graph *g) {
+    int count = (int)g->nodes.size();
+    std::vector<int> placed(count, -1);
+    int done = 0;
+
+    for (int level = 0; done < count; level++) {
+        std::vector<int> ready;
+        for (int i = 0; i < count; i++) {
+            if (placed[i] != -1)
+                continue;
+            bool ok = true;
+            for (int j = 0; j < g->nodes[i].input_count && ok; j++) {
+                int from = g->nodes[i].inputs[j].node;
+                ok = placed[from] != -1 && placed[from] < level;
+            }
+            if (ok)
+                ready.push_back(i);
+        }
+        if (ready.empty())
+            return false;
+
+        graph_level l;
+        l.begin = (int)g->schedule.size();
+        for (size_t i = 0; i < ready.size(); i++) {
+            int kind = g->nodes[ready[i]].kind;
+            if (kind == NODE_VOICES || kind == NODE_GRAINS)
+                g->schedule.push_back(ready[i]);
+        }
+        l.shared = (int)g->schedule.size();
+        for (size_t i = 0; i < ready.size(); i++) {
+            int kind = g->nodes[ready[i]].kind;
+            if (kind != NODE_VOICES && kind != NODE_GRAINS)
+                g->schedule.push_back(ready[i]);
+        }
+        l.end = (int)g->schedule.size();
+        g->levels.push_back(l);
+
+        for (size_t i = 0; i < ready.size(); i++) {
+            placed[ready[i]] = level;
+            g->nodes[ready[i]].level = level;
+        }
+        done += (int)ready.size();
+    }
+    return true;
+}
+
+bool graph_compile(const std::string &spec, const char *origin, int sample_rate, unsigned long block,
+                   graph **out) {
+    graph *g = new graph;
+    g->output = -1;
+    g->block  = block;
+    g->tail   = 0;
+
+    // Inputs are resolved once every name is known, so a spec may list
+    // nodes in any order.
+    std::vector<std::vector<std::pair<std::string, float> > > inputs;
+    std::vector<int> lines;
+    std::istringstream in(spec);
+    std::string line;
+    int line_no = 0;
+    int voices = 0, grains = 0;
+    bool ok = true;
+
+    while (ok && std::getline(in, line)) {
+        line_no++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string name, kind, word;
+        if (!(words >> name))
+            continue;
+
+        graph_node n;
+        node_defaults(&n);
+        node_settings s = {0, 440.0f, 0.707f, 0.25f, 0.0f};
+        std::vector<std::pair<std::string, float> > from;
+
+        if (!(words >> kind) || !parse_name(kind, KIND_NAMES, NODE_KINDS, &n.kind)) {
+            std::cerr << origin << ":" << line_no << ": expected a node kind after " << name << std::endl;
+            ok = false;
+            break;
+        }
+        if (!valid_name(name) || (int)g->nodes.size() == GRAPH_MAX_NODES) {
+            std::cerr << origin << ":" << line_no << ": bad node name or too many nodes: " << name << std::endl;
+            ok = false;
+            break;
+        }
+        for (size_t i = 0; i < g->nodes.size(); i++) {
+            if (g->nodes[i].name == name) {
+                std::cerr << origin << ":" << line_no << ": duplicate node " << name << std::endl;
+                ok = false;
+            }
+        }
+        n.name = name;
+
+        while (ok && words >> word) {
+            size_t eq = word.find('=');
+            if (eq != std::string::npos) {
+                if (!set_param(&n, &s, word.substr(0, eq), word.substr(eq + 1))) {
+                    std::cerr << origin << ":" << line_no << ": unknown key or bad value: " << word << std::endl;
+                    ok = false;
+                }
+                continue;
+            }
+            size_t star = word.find('*');
+            float send = 1.0f;
+            if (star != std::string::npos && !parse_float(word.substr(star + 1), -16.0f, 16.0f, &send)) {
+                std::cerr << origin << ":" << line_no << ": bad send level: " << word << std::endl;
+                ok = false;
+                continue;
+            }
+            from.push_back(std::make_pair(word.substr(0, star), send));
+        }
+        if (!ok)
+            break;
+
+        bool source = n.kind == NODE_VOICES || n.kind == NODE_OSC;
+        if (source ? !from.empty() : from.empty() || from.size() > (size_t)GRAPH_MAX_INPUTS) {
+            std::cerr << origin << ":" << line_no << ": " << kind
+                      << (source ? " takes no inputs" : " needs 1 to 8 inputs") << std::endl;
+            ok = false;
+            break;
+        }
+        voices += n.kind == NODE_VOICES;
+        grains += n.kind == NODE_GRAINS;
+
+        prepare(&n, s, sample_rate);
+        g->tail += settle_time(n, s, sample_rate);
+        g->nodes.push_back(n);
+        inputs.push_back(from);
+        lines.push_back(line_no);
+    }
+
+    for (size_t i = 0; ok && i < g->nodes.size(); i++) {
+        graph_node &n = g->nodes[i];
+        if (n.name == "out")
+            g->output = (int)i;
+        for (size_t j = 0; j < inputs[i].size(); j++) {
+            int from = -1;
+            for (size_t k = 0; k < g->nodes.size(); k++) {
+                if (g->nodes[k].name == inputs[i][j].first)
+                    from = (int)k;
+            }
+            if (from == -1) {
+                std::cerr << origin << ":" << lines[i] << ": unknown input " << inputs[i][j].first << std::endl;
+                ok = false;
+                break;
+            }
+            n.inputs[n.input_count].node = from;
+            n.inputs[n.input_count].send = inputs[i][j].second;
+            n.input_count++;
+        }
+    }
+
+    if (ok && (voices > 1 || grains > 1)) {
+        std::cerr << origin << ": the voices and the grain cloud can each appear once" << std::endl;
+        ok = false;
+    }
+    if (ok && g->output == -1) {
+        std::cerr << origin << ": no node named out" << std::endl;
+        ok = false;
+    }
+    if (ok && !schedule(g)) {
+        std::cerr << origin << ": the graph has a cycle" << std::endl;
+        ok = false;
+    }
+    if (!ok) {
+        delete g;
+        return false;
+    }
+
+    g->buffers.assign(g->nodes.size() * block, 0.0f);
+    for (size_t i = 0; i < g->nodes.size(); i++)
+        g->nodes[i].out = g->buffers.data() + i * block;
+    *out = g;
+    return true;
+}
+
+bool graph_load(const char *path, int sample_rate, unsigned long block, graph **out) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error opening graph: " << path << std::endl;
+        return false;
+    }
+    std::stringstream spec;
+    spec << file.rdbuf();
+    return graph_compile(spec.str(), path, sample_rate, block, out);
+}
+
+void graph_free(graph *g) {
+    delete g;
+}
+
+void graph_bank_init(graph_bank *bank, graph *initial) {
+    bank->current.store(initial);
+    bank->epoch.store(0);
+    bank->retired.clear();
+}
+
+void graph_publish(graph_bank *bank, graph *next) {
+    graph *old = bank->current.exchange(next);
+    bank->retired.push_back(std::make_pair(old, bank->epoch.load()));
+    graph_collect(bank);
+}
+
+void graph_collect(graph_bank *bank) {
+    unsigned long epoch = bank->epoch.load();
+    size_t kept = 0;
+    for (size_t i = 0; i < bank->retired.size(); i++) {
+        if (epoch > bank->retired[i].second)
+            graph_free(bank->retired[i].first);
+        else
+            bank->retired[kept++] = bank->retired[i];
+    }
+    bank->retired.resize(kept);
+}
+
+void graph_bank_free(graph_bank *bank) {
+    for (size_t i = 0; i < bank->retired.size(); i++)
+        graph_free(bank->retired[i].first);
+    bank->retired.clear();
+    graph_free(bank->current.exchange(NULL));
+}
+
+static void filter(graph_node *n, float *x, unsigned long count) {
+    float ic1 = n->ic1, ic2 = n->ic2;
+    for (unsigned long i = 0; i < count; i++) {
+        float v3 = x[i] - ic2;
+        float v1 = n->a1 * ic1 + n->a2 * v3;
+        float v2 = ic2 + n->a2 * ic1 + n->a3 * v3;
+        ic1 = 2.0f * v1 - ic1;
+        ic2 = 2.0f * v2 - ic2;
+        if (n->mode == FILTER_LOWPASS)
+            x[i] = v2;
+        else if (n->mode == FILTER_HIGHPASS)
+            x[i] = x[i] - n->k * v1 - v2;
+        else
+            x[i] = v1;
+    }
+    n->ic1 = ic1;
+    n->ic2 = ic2;
+}
+
+static void delay(graph_node *n, float *x, unsigned long count) {
+    float *line = n->line.data();
+    size_t size = n->line.size();
+    size_t at   = n->write;
+    for (unsigned long i = 0; i < count; i++) {
+        float y  = line[at];
+        line[at] = x[i] + n->feedback * y;
+        x[i]     = y;
+        if (++at == size)
+            at = 0;
+    }
+    n->write = at;
+}
+
+static void run_node(graph *g, graph_node *n, const graph_engine *engine, const dsp_kernels *k,
+                     unsigned long count) {
+    trace_scope span(SPAN_NAMES[n->kind], count);
+    float *out = n->out;
+
+    if (n->kind == NODE_VOICES) {
+        engine->voices(engine->user, out, count);
+    } else if (n->kind == NODE_OSC) {
+        k->oscillator(n->mode, &n->phase, n->increment, out, count);
+    } else {
+        const graph_input &first = n->inputs[0];
+        const float *in = g->nodes[first.node].out;
+        for (unsigned long i = 0; i < count; i++)
+            out[i] = in[i] * first.send;
+        for (int j = 1; j < n->input_count; j++) {
+            in = g->nodes[n->inputs[j].node].out;
+            float send = n->inputs[j].send;
+            for (unsigned long i = 0; i < count; i++)
+                out[i] += in[i] * send;
+        }
+
+        if (n->kind == NODE_GRAINS)
+            engine->grains(engine->user, out, count);
+        else if (n->kind == NODE_FILTER)
+            filter(n, out, count);
+        else if (n->kind == NODE_DELAY)
+            delay(n, out, count);
+    }
+
+    if (n->gain != 1.0f) {
+        for (unsigned long i = 0; i < count; i++)
+            out[i] *= n->gain;
+    }
+}
+
+static inline void spin_pause() {
+#if defined(__SSE2__)
+    _mm_pause();
+#endif
+}
+
+static long futex(std::atomic<int> *word, int op, int value) {
+    return syscall(SYS_futex, (int*)word, op | FUTEX_PRIVATE_FLAG, value, NULL, NULL, 0);
+}
+
+static const uint64_t CLAIM_INDEX = 0xffff;
+
+// Claims and runs shared nodes of the published level until none are left.
+// The job is read before the claim is taken: if the claim word is still the
+// one it was read under, the level has not finished and the job is current.
+static void take_nodes(graph_workers *w) {
+    uint64_t claim = w->claim.load(std::memory_order_acquire);
+    while (true) {
+        uint64_t index = claim & CLAIM_INDEX;
+        uint64_t size  = (claim >> 16) & CLAIM_INDEX;
+        if (index >= size)
+            return;
+        graph *g = w->job.load(std::memory_order_relaxed);
+        int level = w->job_level.load(std::memory_order_relaxed);
+        const dsp_kernels *k = w->job_dsp.load(std::memory_order_relaxed);
+        unsigned long count  = w->job_frames.load(std::memory_order_relaxed);
+        if (!w->claim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel))
+            continue;
+
+        graph_node *n = &g->nodes[g->schedule[g->levels[level].shared + index]];
+        run_node(g, n, NULL, k, count);
+        w->done.fetch_add(1, std::memory_order_release);
+        claim = w->claim.load(std::memory_order_acquire);
+    }
+}
+
+static void worker_loop(graph_workers *w, rt_mode *rt, int index) {
+    trace_thread("graph worker");
+    int priority;
+    rt_setup_worker_thread(rt, index, &priority);
+
+    int seen = w->wake.load();
+    while (!w->stop.load()) {
+        int spins = 0;
+        while (w->wake.load() == seen && !w->stop.load()) {
+            if (++spins < GRAPH_SPIN) {
+                spin_pause();
+                continue;
+            }
+            w->sleepers.fetch_add(1);
+            futex(&w->wake, FUTEX_WAIT, seen);
+            w->sleepers.fetch_sub(1);
+        }
+        seen = w->wake.load();
+        rt_follow_audio(rt, &priority);
+        take_nodes(w);
+    }
+}
+
+void graph_workers_init(graph_workers *w) {
+    w->claim.store(0);
+    w->done.store(0);
+    w->job.store(NULL);
+    w->job_level.store(0);
+    w->job_dsp.store(NULL);
+    w->job_frames.store(0);
+    w->wake.store(0);
+    w->sleepers.store(0);
+    w->stop.store(false);
+    w->generation = 0;
+}
+
+bool graph_workers_start(graph_workers *w, int count, rt_mode *rt) {
+    if (count < 0 || count > GRAPH_MAX_WORKERS) {
+        std::cerr << "Graph workers must be 0-" << GRAPH_MAX_WORKERS << std::endl;
+        return false;
+    }
+    w->stop.store(false);
+    for (int i = 0; i < count; i++)
+        w->threads.push_back(std::thread(worker_loop, w, rt, i));
+    return true;
+}
+
+void graph_workers_stop(graph_workers *w) {
+    if (w->threads.empty())
+        return;
+    w->stop.store(true);
+    w->wake.fetch_add(1);
+    futex(&w->wake, FUTEX_WAKE, INT_MAX);
+    for (size_t i = 0; i < w->threads.size(); i++)
+        w->threads[i].join();
+    w->threads.clear();
+}
+
+void graph_run(graph *g, graph_workers *w, const graph_engine *engine, const dsp_kernels *k,
+               float *out, unsigned long n) {
+    bool parallel = w != NULL && !w->threads.empty();
+
+    for (size_t level = 0; level < g->levels.size(); level++) {
+        const graph_level &l = g->levels[level];
+        int shared = l.end - l.shared;
+
+        if (!parallel || shared < 2) {
+            for (int i = l.begin; i < l.end; i++)
+                run_node(g, &g->nodes[g->schedule[i]], engine, k, n);
+            continue;
+        }
+
+        w->job.store(g, std::memory_order_relaxed);
+        w->job_level.store((int)level, std::memory_order_relaxed);
+        w->job_dsp.store(k, std::memory_order_relaxed);
+        w->job_frames.store(n, std::memory_order_relaxed);
+        w->done.store(0, std::memory_order_relaxed);
+        w->generation++;
+        w->claim.store((uint64_t)w->generation << 32 | (uint64_t)shared << 16, std::memory_order_release);
+        w->wake.fetch_add(1);
+        if (w->sleepers.load() > 0)
+            futex(&w->wake, FUTEX_WAKE, INT_MAX);
+
+        for (int i = l.begin; i < l.shared; i++)
+            run_node(g, &g->nodes[g->schedule[i]], engine, k, n);
+        take_nodes(w);
+
+        int spins = 0;
+        while (w->done.load(std::memory_order_acquire) < shared) {
+            if (++spins < GRAPH_SPIN)
+                spin_pause();
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    const float *result = g->nodes[g->output].out;
+    std::copy(result, result + n, out);
+}
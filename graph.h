@@ -0,0 +1,167 @@
+#ifndef RASKOL_GRAPH_H
+#define RASKOL_GRAPH_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "kernels.h"
+#include "rt.h"
+
+// The signal path as a graph of nodes, one per line of a text spec:
+//
+//   <name> <kind> [input[*send] ...] [key=value ...]
+//
+//   voices  voices                       the played voices
+//   wet     filter voices mode=lowpass cutoff=1200 q=0.7
+//   echo    delay  wet time=0.3 feedback=0.45
+//   out     bus    voices echo*0.4
+//
+// A node's input is the sum of its inputs, each scaled by its send level.
+// The node named `out` feeds the master limiter. A spec compiles into an
+// immutable graph: every node owns a preallocated block buffer, and the
+// nodes are sorted into levels, each depending only on earlier ones.
+// Nodes in the same level run in parallel when there are worker threads;
+// voices and grains work on engine state and always run on the audio
+// thread. A compiled graph is published with a pointer swap, like a patch,
+// and starts with its filters and delays empty.
+
+const int   GRAPH_MAX_NODES   = 32;
+const int   GRAPH_MAX_INPUTS  = 8;
+const int   GRAPH_MAX_WORKERS = 8;
+const float GRAPH_MAX_DELAY   = 2.0f;     // seconds
+const int   GRAPH_SPIN        = 20000;    // polls before a waiting thread sleeps or yields
+
+const int NODE_VOICES = 0;      // the played voices; no inputs
+const int NODE_GRAINS = 1;      // the patch's grain cloud over its input
+const int NODE_OSC    = 2;      // free-running oscillator: waveform, freq; no inputs
+const int NODE_FILTER = 3;      // state-variable filter: mode, cutoff, q
+const int NODE_DELAY  = 4;      // feedback delay, wet only: time, feedback
+const int NODE_BUS    = 5;      // just the sum
+const int NODE_KINDS  = 6;
+
+const int FILTER_LOWPASS  = 0;
+const int FILTER_HIGHPASS = 1;
+const int FILTER_BANDPASS = 2;
+
+typedef struct {
+    int   node;
+    float send;
+}
+graph_input;
+
+typedef struct {
+    std::string name;
+    int   kind;
+    graph_input inputs[GRAPH_MAX_INPUTS];
+    int   input_count;
+    int   level;                // 0 for nodes without inputs
+    float *out;                 // one block
+    float gain;                 // `level=`, applied to the output
+
+    int   mode;                 // oscillator waveform or FILTER_*
+    float phase;                // oscillator
+    float increment;
+    float k, a1, a2, a3;        // filter coefficients
+    float ic1, ic2;             // filter state
+    std::vector<float> line;    // delay line, its length is the delay
+    size_t write;
+    float feedback;
+}
+graph_node;
+
+typedef struct {
+    int begin;                  // schedule[begin, shared): audio thread nodes
+    int shared;                 // schedule[shared, end): any thread
+    int end;
+}
+graph_level;
+
+typedef struct {
+    std::vector<graph_node> nodes;
+    std::vector<int> schedule;          // node indices, level by level
+    std::vector<graph_level> levels;
+    std::vector<float> buffers;
+    int output;
+    unsigned long block;
+    unsigned long tail;         // silent samples out before the delays and filters have decayed
+}
+graph;
+
+// What the voices and grains nodes run; both are called on the audio
+// thread, in schedule order.
+typedef struct {
+    void *user;
+    void (*voices)(void *user, float *out, unsigned long n);
+    void (*grains)(void *user, float *inout, unsigned long n);
+}
+graph_engine;
+
+typedef struct {
+    std::atomic<graph*>         current;
+    std::atomic<unsigned long>  epoch;      // callbacks completed
+    std::vector<std::pair<graph*, unsigned long> > retired;
+}
+graph_bank;
+
+// Worker threads that take the shared nodes of a level. A level is handed
+// out as one word: generation, node count and the next unclaimed node, so
+// a worker that wakes late cannot claim from a level that has moved on.
+typedef struct {
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> claim;
+    std::atomic<int>      done;         // shared nodes finished
+    std::atomic<graph*>   job;
+    std::atomic<int>      job_level;
+    std::atomic<const dsp_kernels*> job_dsp;
+    std::atomic<unsigned long> job_frames;
+    std::atomic<int>      wake;         // futex word, bumped per level
+    std::atomic<int>      sleepers;
+    std::atomic<bool>     stop;
+    uint32_t generation;                // audio thread only
+}
+graph_workers;
+
+// Parses and compiles a spec; errors go to stderr prefixed with `origin`.
+bool graph_compile(const std::string &spec, const char *origin, int sample_rate, unsigned long block,
+                   graph **out);
+
+bool graph_load(const char *path, int sample_rate, unsigned long block, graph **out);
+
+void graph_free(graph *g);
+
+void graph_bank_init(graph_bank *bank, graph *initial);
+
+// Control thread only; the bank takes ownership.
+void graph_publish(graph_bank *bank, graph *next);
+void graph_collect(graph_bank *bank);
+
+// Frees every graph; the stream must be stopped.
+void graph_bank_free(graph_bank *bank);
+
+// Audio thread: bracket every callback, as with patches. The acquired graph
+// is the audio thread's to run until it releases it.
+inline graph *graph_acquire(graph_bank *bank) {
+    return bank->current.load();
+}
+
+inline void graph_release(graph_bank *bank) {
+    bank->epoch.store(bank->epoch.load(std::memory_order_relaxed) + 1);
+}
+
+void graph_workers_init(graph_workers *w);
+
+// Starts `count` workers. With --rt they are set up by
+// rt_setup_worker_thread, pinned from the worker core on if one is given.
+bool graph_workers_start(graph_workers *w, int count, rt_mode *rt);
+
+void graph_workers_stop(graph_workers *w);
+
+// Audio thread: runs the graph over n <= block samples into out.
+void graph_run(graph *g, graph_workers *w, const graph_engine *engine, const dsp_kernels *k,
+               float *out, unsigned long n);
+
+#endif
@@ -0,0 +1,98 @@
+#include "journal.h"
+
+#include <iostream>
+#include <cstring>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char JOURNAL_MAGIC[4] = {'R', 'S', 'K', 'J'};
+
+uint64_t journal_clock_us() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool journal_create(journal_writer *w, const char *path) {
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (w->fd == -1) {
+        std::cerr << "Error creating journal: " << path << std::endl;
+        return false;
+    }
+
+    char header[8];
+    memcpy(header, JOURNAL_MAGIC, 4);
+    memcpy(header + 4, &JOURNAL_VERSION, 4);
+    if (write(w->fd, header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        std::cerr << "Error writing journal: " << path << std::endl;
+        close(w->fd);
+        w->fd = -1;
+        return false;
+    }
+
+    w->last_us = journal_clock_us();
+    return true;
+}
+
+bool journal_append(journal_writer *w, const input_event &event) {
+    if (w->fd == -1)
+        return false;
+
+    uint64_t now   = journal_clock_us();
+    uint64_t delta = now - w->last_us;
+    w->last_us = now;
+
+    journal_entry entry;
+    entry.delta_us = delta > UINT32_MAX ? UINT32_MAX : (uint32_t)delta;
+    entry.type     = event.type;
+    entry.code     = event.code;
+    entry.value    = event.value;
+    return write(w->fd, &entry, sizeof(entry)) == (ssize_t)sizeof(entry);
+}
+
+void journal_close(journal_writer *w) {
+    if (w->fd != -1)
+        close(w->fd);
+    w->fd = -1;
+}
+
+bool journal_load(const char *path, std::vector<journal_entry> *entries) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        std::cerr << "Error opening journal: " << path << std::endl;
+        return false;
+    }
+
+    char header[8];
+    uint32_t version = 0;
+    if (read(fd, header, sizeof(header)) != (ssize_t)sizeof(header) || memcmp(header, JOURNAL_MAGIC, 4) != 0) {
+        std::cerr << "Not an input journal: " << path << std::endl;
+        close(fd);
+        return false;
+    }
+    memcpy(&version, header + 4, 4);
+    if (version != JOURNAL_VERSION) {
+        std::cerr << "Unsupported journal version " << version << ": " << path << std::endl;
+        close(fd);
+        return false;
+    }
+
+    // A torn final entry from a crash is dropped.
+    entries->clear();
+    journal_entry entry;
+    while (read(fd, &entry, sizeof(entry)) == (ssize_t)sizeof(entry))
+        entries->push_back(entry);
+
+    close(fd);
+    return true;
+}
+
+input_event journal_event(const journal_entry &entry) {
+    input_event event;
+    memset(&event, 0, sizeof(event));
+    event.type  = entry.type;
+    event.code  = entry.code;
+    event.value = entry.value;
+    return event;
+}
@@ -0,0 +1,40 @@
+#ifndef RASKOL_JOURNAL_H
+#define RASKOL_JOURNAL_H
+
+#include <linux/input.h>
+#include <stdint.h>
+#include <vector>
+
+// Append-only journal of raw evdev input. The file is an 8-byte header
+// ("RSKJ", little-endian u32 version) followed by fixed 12-byte entries;
+// each entry's delta is the time since the previous one, measured on the
+// monotonic clock when the event was read.
+
+const uint32_t JOURNAL_VERSION = 1;
+
+typedef struct {
+    uint32_t delta_us;
+    uint16_t type;
+    uint16_t code;
+    int32_t  value;
+}
+journal_entry;
+
+typedef struct {
+    int fd;
+    uint64_t last_us;
+}
+journal_writer;
+
+bool journal_create(journal_writer *w, const char *path);
+bool journal_append(journal_writer *w, const input_event &event);
+void journal_close(journal_writer *w);
+
+bool journal_load(const char *path, std::vector<journal_entry> *entries);
+
+input_event journal_event(const journal_entry &entry);
+
+// The clock entries are timed against, in microseconds.
+uint64_t journal_clock_us();
+
+#endif
@@ -0,0 +1,60 @@
+// Baseline kernels, built without architecture flags, and the startup
+// selection between them and the AVX variants.
+#if defined(__x86_64__)
+#define DSP_ISA          "sse2"
+#else
+#define DSP_ISA          "generic"
+#endif
+#define DSP_KERNELS_NAME DSP_KERNELS_BASELINE
+#include "kernels_impl.h"
+
+#include <cstring>
+
+#if defined(RASKOL_KERNELS_X86)
+extern const dsp_kernels DSP_KERNELS_AVX2;
+extern const dsp_kernels DSP_KERNELS_AVX512;
+
+const char *const DSP_ISAS[] = {DSP_ISA, "avx2", "avx512"};
+#else
+const char *const DSP_ISAS[] = {DSP_ISA};
+#endif
+
+const int DSP_ISA_COUNT = sizeof(DSP_ISAS) / sizeof(DSP_ISAS[0]);
+
+static const dsp_kernels *active = &DSP_KERNELS_BASELINE;
+
+const dsp_kernels *dsp_find(const char *isa) {
+    if (strcmp(isa, DSP_ISA) == 0)
+        return &DSP_KERNELS_BASELINE;
+#if defined(RASKOL_KERNELS_X86)
+    __builtin_cpu_init();
+    if (strcmp(isa, "avx2") == 0 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return &DSP_KERNELS_AVX2;
+    if (strcmp(isa, "avx512") == 0 && __builtin_cpu_supports("avx512f"))
+        return &DSP_KERNELS_AVX512;
+#endif
+    return NULL;
+}
+
+bool dsp_select(const char *isa) {
+    if (isa != NULL) {
+        const dsp_kernels *k = dsp_find(isa);
+        if (k == NULL)
+            return false;
+        active = k;
+        return true;
+    }
+
+    for (int i = DSP_ISA_COUNT - 1; i >= 0; i--) {
+        const dsp_kernels *k = dsp_find(DSP_ISAS[i]);
+        if (k != NULL) {
+            active = k;
+            break;
+        }
+    }
+    return true;
+}
+
+const dsp_kernels *dsp_active() {
+    return active;
+}
@@ -0,0 +1,76 @@
+#ifndef RASKOL_KERNELS_H
+#define RASKOL_KERNELS_H
+
+// Hot DSP loops, compiled once per instruction set from kernels_impl.h and
+// picked at startup from cpuid. Only the compiler flags differ between the
+// variants, so a single build runs on any x86-64 and still uses AVX2 or
+// AVX-512 where the host has them.
+
+typedef struct {
+    const char *isa;
+
+    // wave[i] = waveform at *phase; advances *phase by increment per
+    // sample, wrapping at 2*pi like the scalar render.
+    void  (*oscillator)(int waveform, float *phase, float increment, float *wave, unsigned long n);
+
+    // Attack/decay envelope of one voice; writes the per-sample volume.
+    void  (*envelope)(float *volume, float *d_volume, float dx, float *out, unsigned long n);
+
+    // acc[i] += wave[i] * volume[i]
+    void  (*mix)(float *acc, const float *wave, const float *volume, unsigned long n);
+
+    // out[i] = in[i] * gain[i] * scale
+    void  (*apply_gain)(float *out, const float *in, const float *gain, float scale, unsigned long n);
+
+    // Gain each sample needs for its 4x oversampled peak to stay under
+    // ceiling. `in` starts taps - 1 samples of history before the block;
+    // gain[i] belongs to in[i + taps / 2 - 1]. coeffs holds one row of taps
+    // per inter-sample phase (3 rows); scratch holds n floats.
+    void  (*peak_gain)(const float *in, const float *coeffs, int taps, float ceiling,
+                       float *scratch, float *gain, unsigned long n);
+
+    // FIR tap sum; n is a multiple of 16.
+    float (*dot)(const float *a, const float *b, int n);
+
+    // One grain: out[i] += gain * window[w + i * dw] * the source read at
+    // base + offset + i * rate, linearly interpolated. The source is a ring
+    // of mask + 1 samples; offset + n * rate stays small so float keeps the
+    // fraction exact enough, base carries the rest.
+    void  (*grain)(const float *source, unsigned mask, unsigned base, float offset, float rate,
+                   const float *window, float w, float dw, float gain, float *out, unsigned long n);
+
+    // 6-point interpolation of a signal sampled every `factor` samples (2,
+    // 4 or 8): out[i] = sum over j < 6 of taps[j * factor + i % factor]
+    // * low[i / factor + j]. low[k] is the signal at sample (k - 2) * factor.
+    void  (*upsample)(const float *low, const float *taps, int factor, float *out, unsigned long n);
+
+    // Integer PCM: in[i] * scale + dither[i] (dither may be NULL) rounded,
+    // clamped to [-scale, scale) and written to `channels` interleaved
+    // little-endian slots of `bytes` (2, 3 or 4) bytes each.
+    void  (*convert)(const float *in, const float *dither, float scale, int bytes, int channels, void *out,
+                     unsigned long n);
+
+    // out[i] = f(in[i]) with the approximations of fast_math.h, which also
+    // gives their domains and error bounds; pow raises every in[i] to y.
+    void  (*sin_block)(const float *in, float *out, unsigned long n);
+    void  (*exp2_block)(const float *in, float *out, unsigned long n);
+    void  (*log2_block)(const float *in, float *out, unsigned long n);
+    void  (*tanh_block)(const float *in, float *out, unsigned long n);
+    void  (*pow_block)(const float *in, float y, float *out, unsigned long n);
+}
+dsp_kernels;
+
+// Variants built into this binary, slowest first.
+extern const char *const DSP_ISAS[];
+extern const int DSP_ISA_COUNT;
+
+// Kernels for `isa`, or NULL if they were not built or the CPU lacks them.
+const dsp_kernels *dsp_find(const char *isa);
+
+// Picks the kernels later dsp_active() calls return: `isa` if given,
+// otherwise the best the CPU supports. Call once at startup.
+bool dsp_select(const char *isa);
+
+const dsp_kernels *dsp_active();
+
+#endif
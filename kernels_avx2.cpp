@@ -0,0 +1,4 @@
+// Built with -mavx2 -mfma; only reached when cpuid reports both.
+#define DSP_ISA          "avx2"
+#define DSP_KERNELS_NAME DSP_KERNELS_AVX2
+#include "kernels_impl.h"
@@ -0,0 +1,5 @@
+// Built with -mavx512f and 512-bit vectors; only reached when cpuid reports
+// AVX-512F.
+#define DSP_ISA          "avx512"
+#define DSP_KERNELS_NAME DSP_KERNELS_AVX512
+#include "kernels_impl.h"
@@ -0,0 +1,326 @@
+// Body of every kernel variant. Each kernels_*.cpp defines DSP_ISA and
+// DSP_KERNELS_NAME and includes this file under its own compiler flags.
+//
+// Everything here is static and nothing from another header is called
+// unless it is static too (fast_math.h): an inline function emitted from an
+// AVX translation unit could otherwise be picked by the linker for the
+// whole program.
+
+#include "kernels.h"
+#include "fast_math.h"
+
+#if defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+static const float INV_TWO_PI = 0.15915494309189533577f;
+static const double WRAP      = 6.28318530717958647692;   // the scalar render wraps in double
+
+static void oscillator(int waveform, float *phase, float increment, float *__restrict wave, unsigned long n) {
+    float ph = *phase;
+    for (unsigned long i = 0; i < n; i++) {
+        wave[i] = ph;
+        ph += increment;
+        if (ph >= WRAP)
+            ph = (float)(ph - WRAP);
+    }
+    *phase = ph;
+
+    switch (waveform) {
+        case 1: // sawtooth
+            for (unsigned long i = 0; i < n; i++)
+                wave[i] = wave[i] * INV_TWO_PI * 2.0f - 1.0f;
+            break;
+        case 2: // square, first four odd harmonics
+            for (unsigned long i = 0; i < n; i++) {
+                float t = wave[i] * INV_TWO_PI;
+                float v = fast_sin_turns(t) + fast_sin_turns(3.0f * t) * (1.0f / 3.0f)
+                        + fast_sin_turns(5.0f * t) * (1.0f / 5.0f) + fast_sin_turns(7.0f * t) * (1.0f / 7.0f);
+                wave[i] = v * (4.0f / 3.14159265358979323846f);
+            }
+            break;
+        case 3: // triangle
+            for (unsigned long i = 0; i < n; i++) {
+                float d = 2.0f * (wave[i] * INV_TWO_PI) - 1.0f;
+                wave[i] = 2.0f * (d < 0.0f ? -d : d) - 1.0f;
+            }
+            break;
+        default: // sine
+            for (unsigned long i = 0; i < n; i++)
+                wave[i] = fast_sin(wave[i]);
+            break;
+    }
+}
+
+static void envelope(float *volume, float *d_volume, float dx, float *__restrict out, unsigned long n) {
+    float v  = *volume;
+    float dv = *d_volume;
+    for (unsigned long i = 0; i < n; i++) {
+        v += dv * dx;
+        if (v < 1.0f)
+            dv += (1.0f - v) * dx;
+        else
+            dv -= 0.01f * dx;
+        v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+        out[i] = v;
+    }
+    *volume   = v;
+    *d_volume = dv;
+}
+
+static void sin_block(const float *in, float *__restrict out, unsigned long n) {
+    for (unsigned long i = 0; i < n; i++)
+        out[i] = fast_sin(in[i]);
+}
+
+static void exp2_block(const float *in, float *__restrict out, unsigned long n) {
+    for (unsigned long i = 0; i < n; i++)
+        out[i] = fast_exp2(in[i]);
+}
+
+static void log2_block(const float *in, float *__restrict out, unsigned long n) {
+    for (unsigned long i = 0; i < n; i++)
+        out[i] = fast_log2(in[i]);
+}
+
+static void tanh_block(const float *in, float *__restrict out, unsigned long n) {
+    for (unsigned long i = 0; i < n; i++)
+        out[i] = fast_tanh(in[i]);
+}
+
+static void pow_block(const float *in, float y, float *__restrict out, unsigned long n) {
+    for (unsigned long i = 0; i < n; i++)
+        out[i] = fast_pow(in[i], y);
+}
+
+static void mix(float *__restrict acc, const float *__restrict wave, const float *__restrict volume,
+                unsigned long n) {
+    for (unsigned long i = 0; i < n; i++)
+        acc[i] += wave[i] * volume[i];
+}
+
+static void apply_gain(float *__restrict out, const float *__restrict in, const float *__restrict gain,
+                       float scale, unsigned long n) {
+    for (unsigned long i = 0; i < n; i++)
+        out[i] = in[i] * gain[i] * scale;
+}
+
+static void peak_gain(const float *in, const float *coeffs, int taps, float ceiling,
+                      float *__restrict scratch, float *__restrict gain, unsigned long n) {
+    const float *centre = in + taps / 2 - 1;
+    for (unsigned long i = 0; i < n; i++)
+        gain[i] = __builtin_fabsf(centre[i]);
+
+    for (int p = 0; p < 3; p++) {
+        const float *c = coeffs + p * taps;
+        for (unsigned long i = 0; i < n; i++)
+            scratch[i] = 0.0f;
+        for (int t = 0; t < taps; t++) {
+            float k = c[t];
+            for (unsigned long i = 0; i < n; i++)
+                scratch[i] += in[i + t] * k;
+        }
+        for (unsigned long i = 0; i < n; i++) {
+            float a = __builtin_fabsf(scratch[i]);
+            gain[i] = a > gain[i] ? a : gain[i];
+        }
+    }
+
+    for (unsigned long i = 0; i < n; i++)
+        gain[i] = gain[i] > ceiling ? ceiling / gain[i] : 1.0f;
+}
+
+#if defined(__AVX2__)
+static inline float sum256(__m256 v) {
+    __m128 r = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    r = _mm_add_ps(r, _mm_movehl_ps(r, r));
+    r = _mm_add_ss(r, _mm_shuffle_ps(r, r, 1));
+    return _mm_cvtss_f32(r);
+}
+#endif
+
+static float dot(const float *a, const float *b, int n) {
+#if defined(__AVX512F__)
+    __m512 acc = _mm512_setzero_ps();
+    for (int i = 0; i < n; i += 16)
+        acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc);
+    // Through memory: the 512-bit extract intrinsics trip -Wuninitialized
+    // in GCC 12's headers.
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, acc);
+    return sum256(_mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8)));
+#elif defined(__AVX2__) && defined(__FMA__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (int i = 0; i < n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i),     _mm256_loadu_ps(b + i),     acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    return sum256(_mm256_add_ps(acc0, acc1));
+#elif defined(__SSE__)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i),     _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+    return _mm_cvtss_f32(acc0);
+#else
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++)
+        sum += a[i] * b[i];
+    return sum;
+#endif
+}
+
+// Gathers from the source and the window; vectorised across the samples
+// of one grain. Indices are signed 32-bit, which is what the gather
+// instructions take.
+static void grain(const float *source, unsigned mask, unsigned base, float offset, float rate,
+                  const float *window, float w, float dw, float gain, float *__restrict out, unsigned long n) {
+    int m  = (int)mask;
+    int b0 = (int)base;
+    for (int i = 0; i < (int)n; i++) {
+        float p = offset + (float)i * rate;
+        int   k = (int)p;
+        float f = p - (float)k;
+        int   a = (b0 + k) & m;
+        int   b = (a + 1) & m;
+        float s = source[a] + f * (source[b] - source[a]);
+        out[i] += gain * s * window[(int)(w + (float)i * dw)];
+    }
+}
+
+// Each low-rate sample feeds `factor` adjacent outputs, one per tap phase;
+// with the factor fixed that inner loop is a few broadcast multiply-adds.
+template <int factor>
+static void upsample_by(const float *low, const float *taps, float *__restrict out, unsigned long n) {
+    unsigned long whole = n / factor;
+    for (unsigned long m = 0; m < whole; m++) {
+        float *o = out + m * factor;
+        for (int r = 0; r < factor; r++)
+            o[r] = taps[r] * low[m] + taps[factor + r] * low[m + 1] + taps[2 * factor + r] * low[m + 2]
+                 + taps[3 * factor + r] * low[m + 3] + taps[4 * factor + r] * low[m + 4]
+                 + taps[5 * factor + r] * low[m + 5];
+    }
+    for (unsigned long i = whole * factor; i < n; i++) {
+        unsigned long m = i / factor;
+        int r = (int)(i % factor);
+        float sum = 0.0f;
+        for (int j = 0; j < 6; j++)
+            sum += taps[j * factor + r] * low[m + j];
+        out[i] = sum;
+    }
+}
+
+static void upsample(const float *low, const float *taps, int factor, float *out, unsigned long n) {
+    switch (factor) {
+        case 2:  upsample_by<2>(low, taps, out, n); break;
+        case 4:  upsample_by<4>(low, taps, out, n); break;
+        default: upsample_by<8>(low, taps, out, n); break;
+    }
+}
+
+// Nearest integer to in[i] * scale + dither[i], clamped to [-scale,
+// scale). The vector conversions round to nearest even like lrintf; a NaN
+// ends up at the bottom of the range either way.
+static void quantize(const float *in, const float *dither, float scale, int *__restrict out, unsigned long n) {
+    const float low  = -scale;
+    const float high = scale > 16777216.0f ? scale - 128.0f : scale - 1.0f;   // below 2^31 in float
+    unsigned long i = 0;
+#if defined(__AVX512F__)
+    for (; i + 16 <= n; i += 16) {
+        __m512 x = _mm512_mul_ps(_mm512_loadu_ps(in + i), _mm512_set1_ps(scale));
+        if (dither != NULL)
+            x = _mm512_add_ps(x, _mm512_loadu_ps(dither + i));
+        // The zero-masked forms: GCC 12 warns about the undefined
+        // passthrough of the plain ones.
+        x = _mm512_maskz_max_ps(0xffff, x, _mm512_set1_ps(low));
+        x = _mm512_maskz_min_ps(0xffff, x, _mm512_set1_ps(high));
+        _mm512_storeu_si512(out + i, _mm512_maskz_cvtps_epi32(0xffff, x));
+    }
+#elif defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_mul_ps(_mm256_loadu_ps(in + i), _mm256_set1_ps(scale));
+        if (dither != NULL)
+            x = _mm256_add_ps(x, _mm256_loadu_ps(dither + i));
+        x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(low)), _mm256_set1_ps(high));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_cvtps_epi32(x));
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_mul_ps(_mm_loadu_ps(in + i), _mm_set1_ps(scale));
+        if (dither != NULL)
+            x = _mm_add_ps(x, _mm_loadu_ps(dither + i));
+        x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(low)), _mm_set1_ps(high));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_cvtps_epi32(x));
+    }
+#endif
+    for (; i < n; i++) {
+        float x = in[i] * scale + (dither != NULL ? dither[i] : 0.0f);
+        x = x > low ? x : low;
+        x = x < high ? x : high;
+        out[i] = (int)__builtin_lrintf(x);
+    }
+}
+
+// Mono samples into `channels` interleaved slots; one and two channels get
+// their own loops so they vectorise.
+template <typename T>
+static void interleave(const int *q, int channels, T *__restrict out, unsigned long n) {
+    if (channels == 1) {
+        for (unsigned long i = 0; i < n; i++)
+            out[i] = (T)q[i];
+    } else if (channels == 2) {
+        for (unsigned long i = 0; i < n; i++) {
+            out[2 * i]     = (T)q[i];
+            out[2 * i + 1] = (T)q[i];
+        }
+    } else {
+        for (unsigned long i = 0; i < n; i++) {
+            for (int c = 0; c < channels; c++)
+                out[i * channels + c] = (T)q[i];
+        }
+    }
+}
+
+static void convert(const float *in, const float *dither, float scale, int bytes, int channels, void *out,
+                    unsigned long n) {
+    const unsigned long CHUNK = 256;
+    int q[CHUNK];
+    unsigned char *dst = (unsigned char*)out;
+    while (n > 0) {
+        unsigned long m = n < CHUNK ? n : CHUNK;
+        quantize(in, dither, scale, q, m);
+        if (bytes == 2) {
+            interleave(q, channels, (short*)dst, m);
+        } else if (bytes == 4) {
+            interleave(q, channels, (int*)dst, m);
+        } else {
+            unsigned char *o = dst;
+            for (unsigned long i = 0; i < m; i++) {
+                for (int c = 0; c < channels; c++) {
+                    o[0] = (unsigned char)q[i];
+                    o[1] = (unsigned char)(q[i] >> 8);
+                    o[2] = (unsigned char)(q[i] >> 16);
+                    o += 3;
+                }
+            }
+        }
+        dst += m * channels * bytes;
+        in  += m;
+        if (dither != NULL)
+            dither += m;
+        n -= m;
+    }
+}
+
+extern const dsp_kernels DSP_KERNELS_NAME;
+
+const dsp_kernels DSP_KERNELS_NAME = {
+    DSP_ISA, oscillator, envelope, mix, apply_gain, peak_gain, dot, grain, upsample, convert,
+    sin_block, exp2_block, log2_block, tanh_block, pow_block
+};
@@ -0,0 +1,139 @@
+#include "limiter.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// Hann-windowed sinc rows for the points 1/4, 2/4 and 3/4 between samples.
+static void design_true_peak(std::vector<float> *coeffs) {
+    const int taps = TRUE_PEAK_TAPS;
+    coeffs->assign(3 * taps, 0.0f);
+
+    for (int p = 0; p < 3; p++) {
+        double frac = (p + 1) / 4.0;
+        double sum  = 0.0;
+        for (int t = 0; t < taps; t++) {
+            double x    = t - (taps / 2 - 1) - frac;
+            double sinc = std::sin(M_PI * x) / (M_PI * x);
+            double w    = 0.5 + 0.5 * std::cos(M_PI * x / (taps / 2));
+            (*coeffs)[p * taps + t] = (float)(sinc * w);
+            sum += sinc * w;
+        }
+        for (int t = 0; t < taps; t++)
+            (*coeffs)[p * taps + t] = (float)((*coeffs)[p * taps + t] / sum);
+    }
+}
+
+void limiter_init(limiter *l, int sample_rate) {
+    l->ceiling   = LIMITER_CEILING;
+    l->lookahead = std::max(1, (int)std::lround(LIMITER_LOOKAHEAD_MS * 0.001 * sample_rate));
+    l->release   = (float)(1.0 - std::exp(-1.0 / (LIMITER_RELEASE_MS * 0.001 * sample_rate)));
+
+    design_true_peak(&l->coeffs);
+    l->input.assign(TRUE_PEAK_TAPS - 1 + LIMITER_BLOCK, 0.0f);
+    l->delay.assign(l->lookahead + LIMITER_BLOCK, 0.0f);
+    l->required.assign(LIMITER_BLOCK, 1.0f);
+    l->gain.assign(LIMITER_BLOCK, 1.0f);
+    l->scratch.assign(LIMITER_BLOCK, 0.0f);
+
+    size_t cap = 1;
+    while (cap < (size_t)l->lookahead + 2)
+        cap *= 2;
+    l->window_value.assign(cap, 1.0f);
+    l->window_index.assign(cap, 0);
+    l->window_head = 0;
+    l->window_tail = 0;
+
+    l->ramp.assign(l->lookahead, 1.0f);
+    l->ramp_pos = 0;
+    l->ramp_sum = l->lookahead;
+    l->held     = 1.0f;
+    l->position = 0;
+
+    l->blocks.store(0);
+    l->busy_ns.store(0);
+    l->max_ns.store(0);
+    l->min_gain.store(1.0f);
+}
+
+int limiter_latency(const limiter *l) {
+    return l->lookahead + TRUE_PEAK_TAPS / 2;
+}
+
+// Every gain averaged into the ramp is at most the sliding minimum of a
+// window that contains the sample leaving the delay line, so the average
+// is too.
+static float next_gain(limiter *l, float required) {
+    size_t mask = l->window_value.size() - 1;
+
+    while (l->window_tail != l->window_head && l->window_value[(l->window_tail - 1) & mask] >= required)
+        l->window_tail--;
+    l->window_value[l->window_tail & mask] = required;
+    l->window_index[l->window_tail & mask] = l->position;
+    l->window_tail++;
+    while (l->window_index[l->window_head & mask] + l->lookahead < l->position)
+        l->window_head++;
+
+    float minimum = l->window_value[l->window_head & mask];
+    l->held = minimum < l->held ? minimum : l->held + (minimum - l->held) * l->release;
+
+    l->ramp_sum += l->held - l->ramp[l->ramp_pos];
+    l->ramp[l->ramp_pos] = l->held;
+    if (++l->ramp_pos == l->ramp.size())
+        l->ramp_pos = 0;
+
+    l->position++;
+    return (float)(l->ramp_sum / l->lookahead);
+}
+
+void limiter_process(limiter *l, const dsp_kernels *dsp, float *buf, unsigned long n) {
+    auto start = std::chrono::steady_clock::now();
+    const int history = TRUE_PEAK_TAPS - 1;
+    float lowest = 1.0f;
+
+    while (n > 0) {
+        unsigned long m = std::min(n, LIMITER_BLOCK);
+        float *x = l->input.data();
+        float *d = l->delay.data();
+
+        memcpy(x + history, buf, m * sizeof(float));
+        dsp->peak_gain(x, l->coeffs.data(), TRUE_PEAK_TAPS, l->ceiling, l->scratch.data(), l->required.data(), m);
+        memcpy(d + l->lookahead, x + TRUE_PEAK_TAPS / 2 - 1, m * sizeof(float));
+
+        for (unsigned long i = 0; i < m; i++) {
+            l->gain[i] = next_gain(l, l->required[i]);
+            lowest = std::min(lowest, l->gain[i]);
+        }
+        dsp->apply_gain(buf, d, l->gain.data(), 1.0f, m);
+
+        memmove(x, x + m, history * sizeof(float));
+        memmove(d, d + m, l->lookahead * sizeof(float));
+        buf += m;
+        n   -= m;
+    }
+
+    unsigned long ns = (unsigned long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    l->blocks.fetch_add(1, std::memory_order_relaxed);
+    l->busy_ns.fetch_add(ns, std::memory_order_relaxed);
+    if (ns > l->max_ns.load(std::memory_order_relaxed))
+        l->max_ns.store(ns, std::memory_order_relaxed);
+    if (lowest < l->min_gain.load(std::memory_order_relaxed))
+        l->min_gain.store(lowest, std::memory_order_relaxed);
+}
+
+bool limiter_take_stats(limiter *l, limiter_stats *stats) {
+    unsigned long blocks = l->blocks.exchange(0);
+    unsigned long busy   = l->busy_ns.exchange(0);
+    unsigned long worst  = l->max_ns.exchange(0);
+    float lowest         = l->min_gain.exchange(1.0f);
+    if (blocks == 0)
+        return false;
+
+    stats->blocks       = blocks;
+    stats->avg_us       = busy / 1000.0 / blocks;
+    stats->max_us       = worst / 1000.0;
+    stats->reduction_db = 20.0f * std::log10(lowest);
+    return true;
+}
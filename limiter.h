@@ -0,0 +1,73 @@
+#ifndef RASKOL_LIMITER_H
+#define RASKOL_LIMITER_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "kernels.h"
+
+// Lookahead brickwall limiter for the master bus. Peaks are measured on a
+// 4x oversampled copy of the signal (true peak), the gain follows a sliding
+// minimum of what each sample needs and is ramped in over the lookahead, so
+// the output never exceeds the ceiling and the latency is fixed.
+
+const float LIMITER_CEILING      = 0.891f;     // -1 dBTP
+const float LIMITER_LOOKAHEAD_MS = 1.5f;
+const float LIMITER_RELEASE_MS   = 60.0f;
+const int   TRUE_PEAK_TAPS       = 12;
+const unsigned long LIMITER_BLOCK = 256;
+
+typedef struct {
+    unsigned long blocks;
+    double avg_us;
+    double max_us;
+    float  reduction_db;        // deepest gain reduction, 0 or negative
+}
+limiter_stats;
+
+typedef struct {
+    float ceiling;
+    int   lookahead;            // samples
+    float release;              // per-sample recovery coefficient
+    std::vector<float> coeffs;  // 3 inter-sample phases of TRUE_PEAK_TAPS
+    std::vector<float> input;   // TRUE_PEAK_TAPS - 1 samples of history, then the block
+    std::vector<float> delay;   // lookahead samples of history, then the block
+    std::vector<float> required;
+    std::vector<float> gain;
+    std::vector<float> scratch;
+
+    // Monotonic queue holding the minimum required gain over the last
+    // lookahead + 1 samples; power-of-two ring.
+    std::vector<float> window_value;
+    std::vector<unsigned long> window_index;
+    size_t window_head;
+    size_t window_tail;
+
+    std::vector<float> ramp;    // last lookahead held gains, averaged
+    size_t ramp_pos;
+    double ramp_sum;
+    float  held;
+    unsigned long position;
+
+    // Written by the audio thread, drained by limiter_take_stats().
+    std::atomic<unsigned long> blocks;
+    std::atomic<unsigned long> busy_ns;
+    std::atomic<unsigned long> max_ns;
+    std::atomic<float> min_gain;
+}
+limiter;
+
+void limiter_init(limiter *l, int sample_rate);
+
+// Samples between a sample going in and coming out.
+int limiter_latency(const limiter *l);
+
+// Audio thread: limits buf in place.
+void limiter_process(limiter *l, const dsp_kernels *dsp, float *buf, unsigned long n);
+
+// Control thread: collects and resets the per-block cost and gain
+// reduction since the last call. Returns false if no block ran.
+bool limiter_take_stats(limiter *l, limiter_stats *stats);
+
+#endif
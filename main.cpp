@@ -1,138 +1,335 @@
 #include <iostream>
-#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <fcntl.h>
 #include <unistd.h>
 #include <linux/input.h>
 #include <portaudio.h>
 #include <vector>
 #include <algorithm>
-#include <map>
+#include <poll.h>
 
-const int SAMPLE_RATE = 44100;
+#include "journal.h"
+#include "patch_watch.h"
+#include "pcm.h"
+#include "raskol.h"
+#include "recorder.h"
+#include "shm_ring.h"
+#include "wav.h"
+
+const int FRAMES_PER_BUFFER = 512;
+const int CONTROL_POLL_MS   = 100;
+const int REPLAY_TAIL_MS    = 2000;
+const int TELEMETRY_MS      = 5000;
 
 typedef struct {
-    float phase;
-    float amplitude;
-    bool  is_playing;
-    float frequency;
-    float time;
-    float volume;
-    float d_volume;
+    const char *device_path;
+    const char *patch_path;
+    const char *tuning_name;
+    const char *keymap_path;
+    bool rt;
+    int rt_priority;
+    const char *rt_cpus;
+    const char *record_path;
+    const char *replay_path;
+    const char *render_path;
+    const char *isa;
+    bool telemetry;
+    const char *output_path;
+    bool output_direct;
+    const char *control_path;
+    bool share_output;
+    const char *trace_path;
+    const char *grain_source;
+    const char *graph_path;
+    int workers;
+    double idle_suspend;        // seconds; 0 keeps the stream running
+    int format;                 // PCM_*, or -1 to negotiate
+    int dither;                 // DITHER_*, or -1 for the format's default
+    int channels;
 }
-note;
+options;
 
+// What the PortAudio callback works on.
 typedef struct {
-    std::vector<note> notes;
-    float amplitude;
-    std::map<int, int> key_to_note;
-    int waveform;
-    float dx;
+    raskol_engine *engine;
+    recorder *output;           // NULL when not recording
+    shm_ring *shared;           // NULL without --share-output
+    std::atomic<uint64_t> resumed_us;   // stamped by the first callback after a restart
+    pcm_converter pcm;
+    std::vector<float> mono;    // engine output before conversion; unused for mono float
 }
-pa_data;
+stream_context;
 
+// PortAudio formats by PCM_*, and the order they are tried in: integers
+// first, highest resolution first, so the conversion and dither are ours.
+static const PaSampleFormat PA_FORMATS[] = {paFloat32, paInt32, paInt24, paInt16};
+static const int FORMAT_PREFERENCE[]     = {PCM_INT32, PCM_INT24, PCM_INT16, PCM_FLOAT32};
 
 static int call_back(const void *input_buffer, void *output_buffer,
                      unsigned long frames_per_buffer, const PaStreamCallbackTimeInfo* time_info,
                      PaStreamCallbackFlags status_flags, void *synth_data);
 
-void play(const char* device_path);
-
-int get_note(pa_data *data);
-
-float generate_waveform(float phase, int waveform) {
-    float normalizedPhase = phase / (2.0f * M_PI);
-    switch (waveform) {
-        case 0: // sine
-            return sin(phase);
-        case 1: // sawthooth
-            return (normalizedPhase * 2.0f) - 1.0f;
-        case 2: { // square
-            float value = 0.0f;
-            for (int k = 1; k <= 7; k += 2) {
-                value += sin(k * phase) / k;
+static int find_name(const char *const *names, int count, const char *name);
+
+static raskol_engine *load_engine(const options *opts, int sample_rate);
+
+static int negotiate_format(PaStreamParameters *output, int sample_rate, int forced);
+
+static void report_limiter(raskol_engine *engine);
+
+static bool key_event(raskol_engine *engine, const input_event &event);
+
+static void release(raskol_engine *engine, patch_watcher *watcher, journal_writer *journal, int fd);
+
+void play(const options *opts);
+
+void render_offline(const options *opts);
+
+int main(int argc, char **argv) {
+    raskol_config defaults;
+    raskol_config_defaults(&defaults);
+
+    options opts;
+    opts.device_path = "/dev/input/event3";
+    opts.patch_path  = NULL;
+    opts.tuning_name = "12tet";
+    opts.keymap_path = NULL;
+    opts.rt          = false;
+    opts.rt_priority = defaults.rt_priority;
+    opts.rt_cpus     = NULL;
+    opts.record_path = NULL;
+    opts.replay_path = NULL;
+    opts.render_path = NULL;
+    opts.isa         = getenv("RASKOL_ISA");
+    opts.telemetry   = false;
+    opts.output_path   = NULL;
+    opts.output_direct = false;
+    opts.control_path  = NULL;
+    opts.share_output  = false;
+    opts.trace_path    = NULL;
+    opts.grain_source  = NULL;
+    opts.graph_path    = NULL;
+    opts.workers       = 0;
+    opts.idle_suspend  = 0.0;
+    opts.format        = -1;
+    opts.dither        = -1;
+    opts.channels      = 1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--patch" && i + 1 < argc) {
+            opts.patch_path = argv[++i];
+        } else if (arg == "--tuning" && i + 1 < argc) {
+            opts.tuning_name = argv[++i];
+        } else if (arg == "--keymap" && i + 1 < argc) {
+            opts.keymap_path = argv[++i];
+        } else if (arg == "--rt") {
+            opts.rt = true;
+        } else if (arg == "--rt-priority" && i + 1 < argc) {
+            opts.rt_priority = atoi(argv[++i]);
+        } else if (arg == "--rt-cpus" && i + 1 < argc) {
+            opts.rt_cpus = argv[++i];
+        } else if (arg == "--record-input" && i + 1 < argc) {
+            opts.record_path = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            opts.replay_path = argv[++i];
+        } else if (arg == "--render" && i + 1 < argc) {
+            opts.render_path = argv[++i];
+        } else if (arg == "--record" && i + 1 < argc) {
+            opts.output_path = argv[++i];
+        } else if (arg == "--record-direct") {
+            opts.output_direct = true;
+        } else if (arg == "--control" && i + 1 < argc) {
+            opts.control_path = argv[++i];
+        } else if (arg == "--share-output") {
+            opts.share_output = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            opts.trace_path = argv[++i];
+        } else if (arg == "--grain-source" && i + 1 < argc) {
+            opts.grain_source = argv[++i];
+        } else if (arg == "--graph" && i + 1 < argc) {
+            opts.graph_path = argv[++i];
+        } else if (arg == "--workers" && i + 1 < argc) {
+            opts.workers = atoi(argv[++i]);
+        } else if (arg == "--idle-suspend" && i + 1 < argc) {
+            opts.idle_suspend = atof(argv[++i]);
+        } else if (arg == "--format" && i + 1 < argc) {
+            opts.format = find_name(PCM_NAMES, PCM_FORMATS, argv[++i]);
+            if (opts.format == -1) {
+                opts.device_path = NULL;
+                break;
+            }
+        } else if (arg == "--dither" && i + 1 < argc) {
+            opts.dither = find_name(DITHER_NAMES, DITHERS, argv[++i]);
+            if (opts.dither == -1) {
+                opts.device_path = NULL;
+                break;
             }
-            return (4.0f / M_PI) * value;
+        } else if (arg == "--channels" && i + 1 < argc) {
+            opts.channels = atoi(argv[++i]);
+            if (opts.channels < 1) {
+                opts.device_path = NULL;
+                break;
+            }
+        } else if (arg == "--telemetry") {
+            opts.telemetry = true;
+        } else if (arg == "--isa" && i + 1 < argc) {
+            opts.isa = argv[++i];
+        } else if (arg[0] != '-') {
+            opts.device_path = argv[i];
+        } else {
+            opts.device_path = NULL;
+            break;
         }
-        case 3:
-            return 2.0f * fabs(2.0f * normalizedPhase - 1.0f) - 1.0f;
-        default:
-            return sin(phase);
     }
-}
 
-int main() {
-    play("/dev/input/event3");
+    if (opts.device_path == NULL || (opts.render_path != NULL && opts.replay_path == NULL)) {
+        std::cerr << "Usage: " << argv[0] << " [--patch file] [--tuning name|file.scl] [--keymap file.kbm]"
+                  << " [--rt] [--rt-priority n] [--rt-cpus audio,input[,worker]]"
+                  << " [--record-input journal] [--replay journal [--render out.wav]]"
+                  << " [--record out.wav [--record-direct]] [--control socket] [--share-output] [--grain-source file.wav]"
+                  << " [--graph file] [--workers n] [--idle-suspend seconds]"
+                  << " [--format float32|int32|int24|int16] [--dither none|tpdf|shaped] [--channels n]"
+                  << " [--isa sse2|avx2|avx512] [--telemetry] [--trace out.json] [device]" << std::endl;
+        return 1;
+    }
+
+    if (opts.trace_path != NULL) {
+        raskol_trace_start();
+        raskol_trace_thread("control");
+    }
+    if (opts.render_path != NULL)
+        render_offline(&opts);
+    else
+        play(&opts);
+    if (opts.trace_path != NULL)
+        raskol_trace_write(opts.trace_path);
 }
 
 static int call_back(const void *input_buffer, void *output_buffer, unsigned long frames_per_buffer,
                      const PaStreamCallbackTimeInfo* time_info, PaStreamCallbackFlags status_flags,
                      void *synth_data) {
-    pa_data *data = (pa_data*)synth_data;
-    float *out = (float*)output_buffer;
-    (void) input_buffer;
-
-    for (unsigned long i = 0; i < frames_per_buffer; i++) {
-        float sound = 0.0f;
-        int active_notes = 0;
+    // The whole callback, output conversion, recording and sharing included.
+    raskol_guard_scope guard;
 
-        for (size_t j = 0; j < data->notes.size(); j++) {
-            if (data->notes[j].is_playing) {
-                data->notes[j].volume += data->notes[j].d_volume * data->dx;
-
-                if (data->notes[j].volume < 1.0f) {
-                    data->notes[j].d_volume += (1.0f - data->notes[j].volume) * data->dx;
-                } else {
-                    data->notes[j].d_volume -= 0.01f * data->dx;
-                }
+    stream_context *context = (stream_context*)synth_data;
+    (void) input_buffer;
 
-                data->notes[j].volume = std::max(0.0f, std::min(data->notes[j].volume, 1.0f));
+    raskol_trace_thread("audio");
+    raskol_trace_scope span("callback", frames_per_buffer);
+
+    // Mono float is rendered in place; anything else goes through `mono`.
+    const pcm_converter *pcm = &context->pcm;
+    bool direct = pcm->format == PCM_FLOAT32 && pcm->channels == 1;
+    size_t frame_bytes = (size_t)pcm_bytes(pcm->format) * pcm->channels;
+    unsigned char *out = (unsigned char*)output_buffer;
+    while (frames_per_buffer > 0) {
+        unsigned long frames = direct ? frames_per_buffer : std::min<unsigned long>(frames_per_buffer, context->mono.size());
+        float *mono = direct ? (float*)out : context->mono.data();
+        raskol_render(context->engine, mono, frames);
+
+        raskol_trace_scope output("output", frames);
+        if (!direct)
+            pcm_convert(&context->pcm, raskol_convert, mono, out, frames);
+        if (context->output != NULL)
+            recorder_push(context->output, mono, frames);
+        if (context->shared != NULL)
+            shm_ring_write(context->shared, mono, frames);
+        out += frames * frame_bytes;
+        frames_per_buffer -= frames;
+    }
 
-                float waveform = generate_waveform(data->notes[j].phase, data->waveform);
+    if (context->resumed_us.load(std::memory_order_relaxed) == 0)
+        context->resumed_us.store(journal_clock_us(), std::memory_order_relaxed);
+    return paContinue;
+}
 
-                sound += (waveform * data->notes[j].volume);
-                active_notes++;
+static int find_name(const char *const *names, int count, const char *name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0)
+            return i;
+    }
+    return -1;
+}
 
-                data->notes[j].time += data->dx;
-            }
+// The engine as the options describe it, rendering at `sample_rate`.
+static raskol_engine *load_engine(const options *opts, int sample_rate) {
+    raskol_config config;
+    raskol_config_defaults(&config);
+    config.patch_path   = opts->patch_path;
+    config.tuning       = opts->tuning_name;
+    config.keymap_path  = opts->keymap_path;
+    config.graph_path   = opts->graph_path;
+    config.grain_source = opts->grain_source;
+    config.isa          = opts->isa;
+    config.sample_rate  = sample_rate;
+    config.workers      = opts->workers;
+    config.rt           = opts->rt;
+    config.rt_priority  = opts->rt_priority;
+    config.rt_cpus      = opts->rt_cpus;
+    raskol_engine *engine = raskol_create(&config);
+    if (engine == NULL)
+        return NULL;
+
+    raskol_stats stats;
+    raskol_stats_take(engine, &stats);
+    std::cerr << "DSP kernels: " << stats.isa << std::endl;
+    return engine;
+}
 
-            data->notes[j].phase += (data->notes[j].frequency * 2.0f * M_PI) / SAMPLE_RATE;
-            if (data->notes[j].phase >= 2.0f * M_PI)
-                data->notes[j].phase -= 2.0f * M_PI;
-        }
+// The forced format, or the first of FORMAT_PREFERENCE the device takes at
+// this rate and channel count; -1 if there is none.
+static int negotiate_format(PaStreamParameters *output, int sample_rate, int forced) {
+    for (int i = 0; i < PCM_FORMATS; i++) {
+        int format = forced != -1 ? forced : FORMAT_PREFERENCE[i];
+        output->sampleFormat = PA_FORMATS[format];
+        if (Pa_IsFormatSupported(NULL, output, sample_rate) == paFormatIsSupported)
+            return format;
+        if (forced != -1)
+            break;
+    }
+    if (forced != -1)
+        std::cerr << "The output device does not take " << PCM_NAMES[forced];
+    else
+        std::cerr << "The output device takes no known sample format";
+    std::cerr << " with " << output->channelCount << " channel(s) at " << sample_rate << " Hz" << std::endl;
+    return -1;
+}
 
-        if (active_notes > 0) {
-            sound = sound * data->amplitude / active_notes;
-        }
+static void report_limiter(raskol_engine *engine) {
+    raskol_stats stats;
+    raskol_stats_take(engine, &stats);
+    if (stats.limiter_blocks == 0)
+        return;
+    std::cerr << "Limiter: " << stats.limiter_blocks << " blocks, " << stats.limiter_avg_us << " us avg, "
+              << stats.limiter_max_us << " us max per block, " << stats.limiter_reduction_db
+              << " dB peak reduction" << std::endl;
+}
 
-        *out++ = sound;
-    }
-    return paContinue;
+// Keyboard and journal events; false for the quit key.
+static bool key_event(raskol_engine *engine, const input_event &event) {
+    return event.type != EV_KEY || raskol_key(engine, event.code, event.value);
 }
 
-int get_note(pa_data *data) {
-    for (size_t i = 0; i < data->notes.size(); i++) {
-        if (!data->notes[i].is_playing) {
-            return i;
-        }
-    }
+// Tears down what play() set up before its stream, PortAudio included.
+static void release(raskol_engine *engine, patch_watcher *watcher, journal_writer *journal, int fd) {
+    PaError err = Pa_Terminate();
+    if (err != paNoError)
+        std::cerr << "Error terminating PortAudio: " << Pa_GetErrorText(err) << std::endl;
 
-   data->notes.push_back({0.0f, 0.0f, false, 0.0f, 0.0f, 0.0f, 3.0f});
-   return data->notes.size() - 1;
+    raskol_destroy(engine);
+    patch_unwatch(watcher);
+    journal_close(journal);
+    if (fd != -1)
+        close(fd);
 }
 
-void play(const char* device_path) {
+void play(const options *opts) {
     PaError err;
     PaStream *stream;
-    pa_data data;
-    data.amplitude  = 0.5f;
-    data.waveform   = 2;
-    data.dx         = 1.0f / SAMPLE_RATE;
-
-    int fd = open(device_path, O_RDONLY);
-    if (fd == -1) {
-        std::cerr << "Error opening device: " << device_path << std::endl;
-        return;
-    }
 
     err = Pa_Initialize();
     if (err != paNoError) {
@@ -140,107 +337,295 @@ void play(const char* device_path) {
         return;
     }
 
-    err = Pa_OpenDefaultStream(&stream, 0, 1, paFloat32, 44100, 512, call_back, &data);
+    PaStreamParameters output;
+    output.device = Pa_GetDefaultOutputDevice();
+    const PaDeviceInfo *device_info = output.device == paNoDevice ? NULL : Pa_GetDeviceInfo(output.device);
+    if (device_info == NULL) {
+        std::cerr << "No default output device" << std::endl;
+        Pa_Terminate();
+        return;
+    }
+    output.channelCount              = opts->channels;
+    output.suggestedLatency          = device_info->defaultLowOutputLatency;
+    output.hostApiSpecificStreamInfo = NULL;
+
+    // Render at RASKOL_SAMPLE_RATE and convert once to whatever the device runs at.
+    int device_rate = (int)device_info->defaultSampleRate;
+    int format = negotiate_format(&output, device_rate, opts->format);
+    if (format == -1) {
+        Pa_Terminate();
+        return;
+    }
+    raskol_engine *engine = load_engine(opts, device_rate);
+    if (engine == NULL) {
+        Pa_Terminate();
+        return;
+    }
+    if (device_rate != RASKOL_SAMPLE_RATE)
+        std::cerr << "Resampling " << RASKOL_SAMPLE_RATE << " Hz -> " << device_rate << " Hz" << std::endl;
+
+    journal_writer journal;
+    journal.fd = -1;
+    patch_watcher watcher;
+    watcher.fd = -1;
+    int fd = -1;
+
+    std::vector<journal_entry> replay;
+    size_t replay_next = 0;
+    if (opts->replay_path != NULL && !journal_load(opts->replay_path, &replay)) {
+        release(engine, &watcher, &journal, fd);
+        return;
+    }
+
+    if (opts->record_path != NULL && !journal_create(&journal, opts->record_path)) {
+        release(engine, &watcher, &journal, fd);
+        return;
+    }
+
+    if (opts->patch_path != NULL)
+        patch_watch(&watcher, opts->patch_path);
+
+    if (opts->control_path != NULL && !raskol_control_open(engine, opts->control_path)) {
+        release(engine, &watcher, &journal, fd);
+        return;
+    }
+
+    // A replay stands in for the keyboard.
+    if (opts->replay_path == NULL) {
+        fd = open(opts->device_path, O_RDONLY);
+        if (fd == -1) {
+            std::cerr << "Error opening device: " << opts->device_path << std::endl;
+            release(engine, &watcher, &journal, fd);
+            return;
+        }
+    }
+
+    recorder output_recorder;
+    shm_ring shared_ring;
+    shared_ring.fd = -1;
+    stream_context context;
+    context.engine = engine;
+    context.mono.assign(FRAMES_PER_BUFFER, 0.0f);
+    int dither = opts->dither != -1 ? opts->dither
+                                    : (format == PCM_INT24 || format == PCM_INT16 ? DITHER_TPDF : DITHER_NONE);
+    pcm_init(&context.pcm, format, opts->channels, dither, FRAMES_PER_BUFFER);
+    std::cerr << "Output: " << PCM_NAMES[format] << ", " << opts->channels << " channel(s)";
+    if (format != PCM_FLOAT32)
+        std::cerr << ", " << DITHER_NAMES[context.pcm.dither] << " dither";
+    std::cerr << std::endl;
+    context.output = NULL;
+    context.shared = NULL;
+    context.resumed_us.store(1);
+    if (opts->share_output) {
+        if (!shm_ring_create(&shared_ring, device_rate, 1)) {
+            release(engine, &watcher, &journal, fd);
+            return;
+        }
+        context.shared = &shared_ring;
+        raskol_control_share(engine, shared_ring.fd);
+    }
+    if (opts->output_path != NULL) {
+        if (!recorder_start(&output_recorder, opts->output_path, device_rate, opts->output_direct)) {
+            shm_ring_close(&shared_ring, true);
+            release(engine, &watcher, &journal, fd);
+            return;
+        }
+        context.output = &output_recorder;
+    }
+
+    // Integer samples are already clipped and dithered.
+    PaStreamFlags flags = format == PCM_FLOAT32 ? paNoFlag : paClipOff | paDitherOff;
+    err = Pa_OpenStream(&stream, NULL, &output, device_rate, FRAMES_PER_BUFFER, flags, call_back, &context);
     if (err != paNoError) {
         std::cerr << "Error opening PortAudio stream: " << Pa_GetErrorText(err) << std::endl;
-        Pa_Terminate();
+        if (context.output != NULL)
+            recorder_stop(context.output);
+        shm_ring_close(&shared_ring, true);
+        release(engine, &watcher, &journal, fd);
         return;
     }
 
+    raskol_rt_setup(engine);
+
     err = Pa_StartStream(stream);
     if (err != paNoError) {
         std::cerr << "Error starting PortAudio stream: " << Pa_GetErrorText(err) << std::endl;
         Pa_CloseStream(stream);
-        Pa_Terminate();
+        if (context.output != NULL)
+            recorder_stop(context.output);
+        shm_ring_close(&shared_ring, true);
+        release(engine, &watcher, &journal, fd);
         return;
     }
 
-    std::map<int, float> key_frequencies = {
-        {KEY_A, 130.81f}, // C4
-        {KEY_S, 138.59f}, // C#4
-        {KEY_D, 146.83f}, // D4
-        {KEY_F, 155.56f}, // D#4
-        {KEY_G, 164.81f}, // E4
-        {KEY_H, 174.61f}, // F4
-        {KEY_J, 185.0f},  // F#4
-        {KEY_K, 196.0f},  // G4
-        {KEY_K, 207.65f}, // G#4
-        {KEY_L, 220.0f},  // A
-        {KEY_SEMICOLON, 233.08f},   // A#4
-        {KEY_APOSTROPHE, 246.94f},  // B4
-        {KEY_Q, 261.63f}, // C
-        {KEY_2, 277.18f}, // C#
-        {KEY_W, 293.66f}, // D
-        {KEY_3, 311.13f}, // D#
-        {KEY_E, 329.63f}, // E
-        {KEY_R, 349.23f}, // F
-        {KEY_5, 369.99f}, // F#
-        {KEY_T, 392.0f},  // G
-        {KEY_6, 415.30f}, // G#
-        {KEY_Y, 440.0f},  // A
-        {KEY_7, 466.16f}, // A#
-        {KEY_U, 493.88f}, // B
-        {KEY_I, 523.25f}, // C6
-        {KEY_9, 554.37f}, // C#6
-        {KEY_O, 587.33f}, // D6
-        {KEY_0, 622.25f}, // D#6
-        {KEY_P, 659.25f}, // E6
-        {KEY_LEFTBRACE, 698.46f},  // F6
-        {KEY_EQUAL, 739.99f},      // F#6
-        {KEY_RIGHTBRACE, 783.99f}  // G
-    };
-
     input_event event;
     bool playing = true;
 
+    // Negative fds are ignored by poll().
+    pollfd fds[3];
+    fds[0].fd     = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd     = watcher.fd;
+    fds[1].events = POLLIN;
+    fds[2].fd     = raskol_control_fd(engine);
+    fds[2].events = POLLIN;
+
+    uint64_t replay_at = journal_clock_us() + (replay.empty() ? REPLAY_TAIL_MS * 1000 : replay[0].delta_us);
+    uint64_t report_at = journal_clock_us() + TELEMETRY_MS * 1000;
+
+    // After --idle-suspend seconds of idle engine the stream is stopped; the
+    // next note event starts it again, timed from here to its first callback.
+    double   idle_limit  = opts->idle_suspend;
+    bool     suspended   = false;
+    uint64_t resume_from = 0;
+
     while (playing) {
-        ssize_t n = read(fd, &event, sizeof(event));
-        if (n == sizeof(event)) {
-            if (event.type == EV_KEY) {
-                auto freq_it = key_frequencies.find(event.code);
-                if (freq_it != key_frequencies.end()) {
-                    if (event.value == 1) {
-                        int note_idx = get_note(&data);
-                        data.notes[note_idx].time = 0.0f;
-                        data.notes[note_idx].frequency = freq_it->second;
-                        data.notes[note_idx].is_playing = true;
-                        data.key_to_note[event.code] = note_idx;
-                    } else if (event.value == 0) {
-                        auto note_it = data.key_to_note.find(event.code);
-                        if (note_it != data.key_to_note.end()) {
-                            data.notes[note_it->second].is_playing = false;
-                            data.key_to_note.erase(note_it);
-                        }
-                    }
-                } else if (event.code == KEY_Z && event.value == 1) {
-                    playing = false;
-                }
-                else if (event.code == KEY_X) data.waveform = 0;
-                else if (event.code == KEY_C) data.waveform = 1;
-                else if (event.code == KEY_V) data.waveform = 2;
-                else if (event.code == KEY_B) data.waveform = 3;
+        if (suspended && raskol_pending(engine)) {
+            resume_from = journal_clock_us();
+            context.resumed_us.store(0);
+            raskol_rt_restart(engine);
+            err = Pa_StartStream(stream);
+            if (err != paNoError) {
+                std::cerr << "Error resuming PortAudio stream: " << Pa_GetErrorText(err) << std::endl;
+                break;
+            }
+            suspended = false;
+        } else if (!suspended && resume_from == 0 && idle_limit > 0.0 && raskol_idle_seconds(engine) >= idle_limit) {
+            err = Pa_StopStream(stream);
+            if (err != paNoError) {
+                std::cerr << "Error suspending PortAudio stream: " << Pa_GetErrorText(err) << std::endl;
+                idle_limit = 0.0;
+            } else {
+                suspended = true;
+                std::cerr << "Idle: stream suspended" << std::endl;
+            }
+        }
+        uint64_t resumed_us = context.resumed_us.load();
+        if (resume_from != 0 && resumed_us != 0) {
+            const PaStreamInfo *info = Pa_GetStreamInfo(stream);
+            std::cerr << "Stream resumed: first buffer out " << (double)(resumed_us - resume_from) / 1000.0
+                      << " ms after the note, plus " << (info != NULL ? info->outputLatency * 1000.0 : 0.0)
+                      << " ms of output latency" << std::endl;
+            resume_from = 0;
+        }
 
+        int timeout = suspended && !opts->telemetry ? -1 : CONTROL_POLL_MS;
+        if (opts->replay_path != NULL) {
+            uint64_t now = journal_clock_us();
+            timeout = replay_at <= now ? 0 : (int)std::min<uint64_t>(CONTROL_POLL_MS, (replay_at - now + 999) / 1000);
+        }
+
+        int ready = poll(fds, 3, timeout);
+        raskol_collect(engine);
+        raskol_rt_report(engine);
+        if (context.output != NULL) {
+            unsigned long dropped = recorder_take_dropped(context.output);
+            if (dropped > 0)
+                std::cerr << "Recording: writer fell behind, dropped " << dropped << " samples" << std::endl;
+        }
+        if (opts->telemetry && journal_clock_us() >= report_at) {
+            report_limiter(engine);
+            report_at += TELEMETRY_MS * 1000;
+        }
+
+        if (opts->replay_path != NULL && journal_clock_us() >= replay_at) {
+            if (replay_next == replay.size()) {
+                playing = false;
+                continue;
+            }
+            raskol_trace_scope span("replay");
+            while (playing && replay_next < replay.size() && journal_clock_us() >= replay_at) {
+                playing = key_event(engine, journal_event(replay[replay_next++]));
+                replay_at += replay_next < replay.size() ? replay[replay_next].delta_us : REPLAY_TAIL_MS * 1000;
             }
         }
 
+        if (ready <= 0)
+            continue;
 
+        if (watcher.fd != -1 && (fds[1].revents & POLLIN) && patch_watch_changed(&watcher)) {
+            raskol_trace_scope span("patch");
+            if (raskol_load_patch(engine, opts->patch_path))
+                std::cerr << "Reloaded patch: " << opts->patch_path << std::endl;
+        }
+
+        if (fds[2].fd != -1 && (fds[2].revents & POLLIN)) {
+            raskol_trace_scope span("control");
+            playing = raskol_control_poll(engine) && playing;
+        }
+
+        if (!(fds[0].revents & POLLIN))
+            continue;
+
+        ssize_t n = read(fd, &event, sizeof(event));
+        if (n == sizeof(event)) {
+            raskol_trace_scope span("input", event.code);
+            journal_append(&journal, event);
+            playing = key_event(engine, event);
+        }
     }
-    err = Pa_StopStream(stream);
-    if (err != paNoError) {
+    err = suspended ? paNoError : Pa_StopStream(stream);
+    if (context.output != NULL && !recorder_stop(context.output))
+        std::cerr << "Error finishing " << opts->output_path << std::endl;
+    shm_ring_close(&shared_ring, true);
+    if (err != paNoError)
         std::cerr << "Error stopping PortAudio stream: " << Pa_GetErrorText(err) << std::endl;
-        return;
-    }
 
     err = Pa_CloseStream(stream);
-    if (err != paNoError) {
+    if (err != paNoError)
         std::cerr << "Error closing PortAudio stream: " << Pa_GetErrorText(err) << std::endl;
-        return;
+
+    release(engine, &watcher, &journal, fd);
+}
+
+static void render_until(raskol_engine *engine, wav_writer *wav, std::vector<float> &block,
+                         uint64_t *rendered, uint64_t target) {
+    while (*rendered < target) {
+        unsigned long frames = (unsigned long)std::min<uint64_t>(block.size(), target - *rendered);
+        raskol_render_exact(engine, block.data(), frames);
+        wav_write(wav, block.data(), frames);
+        *rendered += frames;
     }
+}
 
-    err = Pa_Terminate();
-    if (err != paNoError) {
-        std::cerr << "Error terminating PortAudio: " << Pa_GetErrorText(err) << std::endl;
+// Replays a journal as fast as possible, applying every event at the exact
+// sample it was played at.
+void render_offline(const options *opts) {
+    std::vector<journal_entry> replay;
+    if (!journal_load(opts->replay_path, &replay))
+        return;
+    raskol_engine *engine = load_engine(opts, RASKOL_SAMPLE_RATE);
+    if (engine == NULL)
+        return;
+
+    wav_writer wav;
+    if (!wav_create(&wav, opts->render_path, RASKOL_SAMPLE_RATE, 1)) {
+        raskol_destroy(engine);
+        return;
     }
 
-    close(fd);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<float> block(FRAMES_PER_BUFFER);
+    uint64_t rendered = 0;
+    uint64_t clock_us = 0;
+    bool playing = true;
+
+    for (size_t i = 0; i < replay.size() && playing; i++) {
+        clock_us += replay[i].delta_us;
+        render_until(engine, &wav, block, &rendered, clock_us * RASKOL_SAMPLE_RATE / 1000000);
+        playing = key_event(engine, journal_event(replay[i]));
+        raskol_collect(engine);
+    }
+    if (playing)
+        render_until(engine, &wav, block, &rendered, rendered + (uint64_t)REPLAY_TAIL_MS * RASKOL_SAMPLE_RATE / 1000);
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!wav_close(&wav))
+        std::cerr << "Error writing " << opts->render_path << std::endl;
+
+    std::cerr << "Rendered " << replay.size() << " events, " << (double)rendered / RASKOL_SAMPLE_RATE
+              << " s of audio in " << elapsed << " s" << std::endl;
+    if (opts->telemetry)
+        report_limiter(engine);
+    raskol_destroy(engine);
 }
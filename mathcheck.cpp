@@ -0,0 +1,188 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "kernels.h"
+#include "fast_math.h"
+
+// Checks the approximations of fast_math.h against double libm: every
+// function over its documented domain, as the inline scalar version and
+// as the block kernel of each ISA. Prints the worst error next to the
+// bound, and the cost per sample next to libm's float version. Exits
+// non-zero if any bound is exceeded.
+
+const unsigned long POINTS = 1 << 20;
+const int COST_REPEATS     = 16;
+
+static const float POW_EXPONENTS[] = {-4.0f, -2.5f, -1.0f, -0.5f, 0.25f, 1.0f, 1.7f, 3.0f, 4.0f};
+static const int   POW_EXPONENT_COUNT = sizeof(POW_EXPONENTS) / sizeof(POW_EXPONENTS[0]);
+
+typedef enum {FN_SIN, FN_EXP2, FN_LOG2, FN_TANH, FN_POW} function_id;
+
+// How the error is measured: absolute, relative to the exact value, or
+// relative once the exact value is past 1.
+typedef enum {ERROR_ABSOLUTE, ERROR_RELATIVE, ERROR_MIXED} error_kind;
+
+static const char *ERROR_NAMES[] = {"abs", "rel", "mix"};
+
+typedef struct {
+    const char *name;
+    const char *domain;
+    function_id id;
+    double lo, hi;
+    bool   logarithmic;     // points spaced evenly in log(x)
+    error_kind error;
+    float  bound;
+}
+function_case;
+
+static const function_case CASES[] = {
+    {"sin",  "[-2pi, 2pi]",         FN_SIN,  -2.0 * M_PI, 2.0 * M_PI, false, ERROR_ABSOLUTE, FAST_SIN_MAX_ERROR},
+    {"exp2", "[-126, 127]",         FN_EXP2, -126.0,      127.0,      false, ERROR_RELATIVE, FAST_EXP2_MAX_ERROR},
+    {"log2", "[1e-30, 1e30]",       FN_LOG2, 1e-30,       1e30,       true,  ERROR_MIXED,    FAST_LOG2_MAX_ERROR},
+    {"tanh", "[-12, 12]",           FN_TANH, -12.0,       12.0,       false, ERROR_ABSOLUTE, FAST_TANH_MAX_ERROR},
+    {"tanh", "[-1e6, 1e6]",         FN_TANH, -1e6,        1e6,        false, ERROR_ABSOLUTE, FAST_TANH_MAX_ERROR},
+    {"pow",  "[1e-3, 1e3]^[-4, 4]", FN_POW,  1e-3,        1e3,        true,  ERROR_RELATIVE, FAST_POW_MAX_ERROR}
+};
+
+static double exact(function_id id, double x, double y) {
+    switch (id) {
+        case FN_SIN:  return std::sin(x);
+        case FN_EXP2: return std::exp2(x);
+        case FN_LOG2: return std::log2(x);
+        case FN_TANH: return std::tanh(x);
+        default:      return std::pow(x, y);
+    }
+}
+
+static void run_scalar(function_id id, const float *in, float y, float *out, unsigned long n) {
+    switch (id) {
+        case FN_SIN:  for (unsigned long i = 0; i < n; i++) out[i] = fast_sin(in[i]);     break;
+        case FN_EXP2: for (unsigned long i = 0; i < n; i++) out[i] = fast_exp2(in[i]);    break;
+        case FN_LOG2: for (unsigned long i = 0; i < n; i++) out[i] = fast_log2(in[i]);    break;
+        case FN_TANH: for (unsigned long i = 0; i < n; i++) out[i] = fast_tanh(in[i]);    break;
+        default:      for (unsigned long i = 0; i < n; i++) out[i] = fast_pow(in[i], y);  break;
+    }
+}
+
+static void run_kernel(const dsp_kernels *k, function_id id, const float *in, float y, float *out,
+                       unsigned long n) {
+    switch (id) {
+        case FN_SIN:  k->sin_block(in, out, n);     break;
+        case FN_EXP2: k->exp2_block(in, out, n);    break;
+        case FN_LOG2: k->log2_block(in, out, n);    break;
+        case FN_TANH: k->tanh_block(in, out, n);    break;
+        default:      k->pow_block(in, y, out, n);  break;
+    }
+}
+
+static void run_libm(function_id id, const float *in, float y, float *out, unsigned long n) {
+    switch (id) {
+        case FN_SIN:  for (unsigned long i = 0; i < n; i++) out[i] = std::sin(in[i]);     break;
+        case FN_EXP2: for (unsigned long i = 0; i < n; i++) out[i] = std::exp2(in[i]);    break;
+        case FN_LOG2: for (unsigned long i = 0; i < n; i++) out[i] = std::log2(in[i]);    break;
+        case FN_TANH: for (unsigned long i = 0; i < n; i++) out[i] = std::tanh(in[i]);    break;
+        default:      for (unsigned long i = 0; i < n; i++) out[i] = std::pow(in[i], y);  break;
+    }
+}
+
+// One implementation: the scalar inline functions (dsp NULL), a kernel or
+// libm.
+typedef struct {
+    std::string name;
+    const dsp_kernels *dsp;
+    bool libm;              // cost only
+}
+variant;
+
+static void run(const variant &v, function_id id, const float *in, float y, float *out, unsigned long n) {
+    if (v.libm)
+        run_libm(id, in, y, out, n);
+    else if (v.dsp == NULL)
+        run_scalar(id, in, y, out, n);
+    else
+        run_kernel(v.dsp, id, in, y, out, n);
+}
+
+static void make_points(const function_case &c, std::vector<float> *points) {
+    points->resize(POINTS);
+    for (unsigned long i = 0; i < POINTS; i++) {
+        double f = (double)i / (POINTS - 1);
+        (*points)[i] = c.logarithmic ? (float)(c.lo * std::pow(c.hi / c.lo, f)) : (float)(c.lo + (c.hi - c.lo) * f);
+    }
+}
+
+static double max_error(const function_case &c, const variant &v, const std::vector<float> &in,
+                        std::vector<float> *out) {
+    double worst = 0.0;
+    int exponents = c.id == FN_POW ? POW_EXPONENT_COUNT : 1;
+    for (int e = 0; e < exponents; e++) {
+        float y = c.id == FN_POW ? POW_EXPONENTS[e] : 0.0f;
+        run(v, c.id, in.data(), y, out->data(), POINTS);
+        for (unsigned long i = 0; i < POINTS; i++) {
+            double want = exact(c.id, in[i], y);
+            double err  = std::fabs((*out)[i] - want);
+            if (c.error == ERROR_RELATIVE)
+                err /= std::fabs(want);
+            else if (c.error == ERROR_MIXED)
+                err /= std::max(1.0, std::fabs(want));
+            worst = std::max(worst, err);
+        }
+    }
+    return worst;
+}
+
+static double cost_ns(const function_case &c, const variant &v, const std::vector<float> &in,
+                      std::vector<float> *out) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < COST_REPEATS; r++)
+        run(v, c.id, in.data(), 1.7f, out->data(), POINTS);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    volatile float sink = (*out)[POINTS - 1];
+    (void)sink;
+    return elapsed * 1e9 / ((double)POINTS * COST_REPEATS);
+}
+
+int main() {
+    std::vector<variant> variants;
+    variants.push_back({"scalar", NULL, false});
+    for (int i = 0; i < DSP_ISA_COUNT; i++) {
+        const dsp_kernels *k = dsp_find(DSP_ISAS[i]);
+        if (k != NULL)
+            variants.push_back({std::string("kernel/") + DSP_ISAS[i], k, false});
+    }
+    variants.push_back({"libm", NULL, true});
+
+    std::vector<float> in;
+    std::vector<float> out(POINTS);
+    bool ok = true;
+
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+        const function_case &c = CASES[i];
+        make_points(c, &in);
+        for (size_t j = 0; j < variants.size(); j++) {
+            const variant &v = variants[j];
+            double ns = cost_ns(c, v, in, &out);
+            std::cout << std::left << std::setw(6) << c.name << std::setw(22) << c.domain << std::setw(16) << v.name
+                      << std::right;
+            if (v.libm) {
+                std::cout << std::setw(43) << "" << std::fixed << std::setprecision(2) << std::setw(7) << ns
+                          << " ns/sample" << std::endl;
+                continue;
+            }
+            double err = max_error(c, v, in, &out);
+            bool pass  = err <= c.bound;
+            ok = pass && ok;
+            std::cout << ERROR_NAMES[c.error] << " error " << std::scientific << std::setprecision(3)
+                      << err << " (bound " << std::setprecision(1) << c.bound << ")  " << std::fixed
+                      << std::setprecision(2) << std::setw(7) << ns << " ns/sample  " << (pass ? "ok" : "FAIL")
+                      << std::endl;
+        }
+    }
+    return ok ? 0 : 1;
+}
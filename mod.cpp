@@ -0,0 +1,97 @@
+#include "mod.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "fast_math.h"
+
+void mod_init(mod_lfos *m) {
+    for (int i = 0; i < MOD_LFOS; i++) {
+        m->phase[i] = 0.0f;
+        m->value[i] = 0.0f;
+    }
+    m->random = 0x2545f491u;
+}
+
+bool mod_active(const patch *p) {
+    for (int i = 0; i < MOD_ROUTES; i++) {
+        if (p->routes[i].source != MOD_NONE && p->routes[i].depth != 0.0f)
+            return true;
+    }
+    return false;
+}
+
+static float next_random(mod_lfos *m) {
+    m->random ^= m->random << 13;
+    m->random ^= m->random >> 17;
+    m->random ^= m->random << 5;
+    return (float)(m->random >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+void mod_advance(mod_lfos *m, const patch *p, int sample_rate) {
+    for (int i = 0; i < MOD_LFOS; i++) {
+        float phase = m->phase[i];
+        switch (p->lfo_shape[i]) {
+            case LFO_TRIANGLE:
+                m->value[i] = 1.0f - 4.0f * std::fabs(phase - 0.5f);
+                break;
+            case LFO_SAW:
+                m->value[i] = 2.0f * phase - 1.0f;
+                break;
+            case LFO_SQUARE:
+                m->value[i] = phase < 0.5f ? 1.0f : -1.0f;
+                break;
+            case LFO_RANDOM:
+                if (phase == 0.0f)
+                    m->value[i] = next_random(m);
+                break;
+            default:
+                m->value[i] = fast_sin(FAST_TWO_PI * phase);
+                break;
+        }
+
+        phase += p->lfo_rate[i] * p->control_period / sample_rate;
+        if (phase >= 1.0f) {
+            phase -= std::floor(phase);
+            // The sample and hold picks a new value on every wrap.
+            if (p->lfo_shape[i] == LFO_RANDOM)
+                m->value[i] = next_random(m);
+        }
+        m->phase[i] = phase;
+    }
+}
+
+// Linear attack to 1, then linear decay to 0.
+static float envelope(const patch *p, uint64_t age, int sample_rate) {
+    float t = (float)age / sample_rate;
+    if (t < p->mod_attack)
+        return t / p->mod_attack;
+    if (p->mod_decay <= 0.0f)
+        return 0.0f;
+    return std::max(0.0f, 1.0f - (t - p->mod_attack) / p->mod_decay);
+}
+
+void mod_targets(const mod_lfos *m, const patch *p, uint64_t age, int sample_rate,
+                 float *pitch, float *gain) {
+    float semitones = 0.0f;
+    float amp       = 1.0f;
+
+    for (int i = 0; i < MOD_ROUTES; i++) {
+        const mod_route &r = p->routes[i];
+        float source;
+        if (r.source == MOD_LFO1 || r.source == MOD_LFO2)
+            source = m->value[r.source - MOD_LFO1];
+        else if (r.source == MOD_ENV)
+            source = envelope(p, age, sample_rate);
+        else
+            continue;
+
+        if (r.target == MOD_PITCH)
+            semitones += r.depth * source;
+        else
+            amp += r.depth * source;
+    }
+
+    *pitch = fast_exp2(semitones * (1.0f / 12.0f));
+    *gain  = std::max(amp, 0.0f);
+}
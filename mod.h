@@ -0,0 +1,33 @@
+#ifndef RASKOL_MOD_H
+#define RASKOL_MOD_H
+
+#include <cstdint>
+
+#include "patch.h"
+
+// Control-rate modulation. The LFOs and the routing are evaluated once
+// every patch::control_period samples instead of per sample; the render
+// then steps each voice's pitch at that rate and ramps its gain linearly
+// between control points so amplitude changes stay free of zipper noise.
+
+typedef struct {
+    float phase[MOD_LFOS];      // cycles, 0-1
+    float value[MOD_LFOS];      // -1 to 1, as of the last control point
+    uint32_t random;
+}
+mod_lfos;
+
+void mod_init(mod_lfos *m);
+
+// True if any route has a source and a non-zero depth. Without one the
+// render skips modulation entirely.
+bool mod_active(const patch *p);
+
+// Samples the LFOs for this control point and advances them by one period.
+void mod_advance(mod_lfos *m, const patch *p, int sample_rate);
+
+// Pitch ratio and gain for a voice `age` samples after it started.
+void mod_targets(const mod_lfos *m, const patch *p, uint64_t age, int sample_rate,
+                 float *pitch, float *gain);
+
+#endif
@@ -0,0 +1,328 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "synth.h"
+
+// Sweeps every oscillator implementation across the key range and reports
+// how far each one is from the ideal band-limited waveform, and what it
+// costs. For each tone the output is windowed and FFT'd; energy within a
+// window main lobe of a harmonic below Nyquist is that harmonic, the rest
+// is aliasing and noise.
+//
+//   SNR       ideal signal against all error: aliasing plus harmonic
+//             deviation
+//   alias     non-harmonic energy against the ideal signal
+//   THD       deviation of the harmonic amplitudes from the ideal ones,
+//             against the fundamental (plain THD for the sine)
+//
+// The ideal square is the engine's four-harmonic one, not a full-band
+// square. `oscillators --sweep` prints every note instead of the worst case.
+
+const unsigned long FFT_SIZE    = 1 << 16;
+const unsigned long BLOCK       = 256;
+const unsigned long COST_FRAMES = 1 << 21;
+const int LOBE_BINS   = 8;      // window main lobe half width, rounded up
+const int FIRST_NOTE  = 24;     // C1
+const int LAST_NOTE   = 108;    // C8
+const int NOTE_STEP   = 6;
+
+static const char *WAVEFORM_NAMES[] = {"sine", "saw", "square", "triangle"};
+
+typedef struct oscillator_impl oscillator_impl;
+
+struct oscillator_impl {
+    std::string name;
+    const dsp_kernels *dsp;     // kernel variants only
+    bool (*supports)(int waveform);
+    // Renders n samples of one voice; *phase carries over between calls.
+    void (*render)(const oscillator_impl *impl, int waveform, float *phase, float increment,
+                   float *out, unsigned long n);
+};
+
+typedef struct {
+    double snr_db;
+    double alias_db;
+    double thd_db;
+}
+quality;
+
+static bool all_waveforms(int) {
+    return true;
+}
+
+static bool saw_and_triangle(int waveform) {
+    return waveform == 1 || waveform == 3;
+}
+
+static bool saw_only(int waveform) {
+    return waveform == 1;
+}
+
+// generate_waveform with the scalar render's phase wrap.
+static void render_reference(const oscillator_impl *, int waveform, float *phase, float increment,
+                             float *out, unsigned long n) {
+    float ph = *phase;
+    for (unsigned long i = 0; i < n; i++) {
+        out[i] = generate_waveform(ph, waveform);
+        ph += increment;
+        if (ph >= 2.0f * M_PI)
+            ph -= 2.0f * M_PI;
+    }
+    *phase = ph;
+}
+
+static void render_dsp(const oscillator_impl *impl, int waveform, float *phase, float increment,
+                          float *out, unsigned long n) {
+    impl->dsp->oscillator(waveform, phase, increment, out, n);
+}
+
+// Two-sample polynomial correction of the saw's step.
+static float poly_blep(float t, float dt) {
+    if (t < dt) {
+        t /= dt;
+        return t + t - t * t - 1.0f;
+    }
+    if (t > 1.0f - dt) {
+        t = (t - 1.0f) / dt;
+        return t * t + t + t + 1.0f;
+    }
+    return 0.0f;
+}
+
+static void render_polyblep(const oscillator_impl *, int, float *phase, float increment,
+                            float *out, unsigned long n) {
+    const float two_pi = 2.0f * (float)M_PI;
+    float ph = *phase;
+    float dt = increment / two_pi;
+    for (unsigned long i = 0; i < n; i++) {
+        float t = ph / two_pi;
+        out[i] = 2.0f * t - 1.0f - poly_blep(t, dt);
+        ph += increment;
+        if (ph >= two_pi)
+            ph -= two_pi;
+    }
+    *phase = ph;
+}
+
+// Sum of every harmonic below Nyquist: the quality ceiling, at a cost that
+// grows with the number of harmonics.
+static void render_additive(const oscillator_impl *, int waveform, float *phase, float increment,
+                            float *out, unsigned long n) {
+    float ph = *phase;
+    int harmonics = (int)(M_PI / increment);
+    for (unsigned long i = 0; i < n; i++) {
+        // sin and cos of k * ph by rotation, one harmonic at a time.
+        double c1 = std::cos((double)ph), s1 = std::sin((double)ph);
+        double ck = c1, sk = s1;
+        double sum = 0.0;
+        for (int k = 1; k <= harmonics; k++) {
+            if (waveform == 1)
+                sum -= sk * 2.0 / (M_PI * k);
+            else if (k & 1)
+                sum += ck * 8.0 / (M_PI * M_PI * k * k);
+            double c = ck * c1 - sk * s1;
+            sk = sk * c1 + ck * s1;
+            ck = c;
+        }
+        out[i] = (float)sum;
+        ph += increment;
+        if (ph >= 2.0f * M_PI)
+            ph -= 2.0f * M_PI;
+    }
+    *phase = ph;
+}
+
+// Magnitude of harmonic k of the ideal waveform, for unit amplitude.
+static double ideal_harmonic(int waveform, int k) {
+    switch (waveform) {
+        case 1:
+            return 2.0 / (M_PI * k);
+        case 2:
+            return (k & 1) && k <= 7 ? 4.0 / (M_PI * k) : 0.0;
+        case 3:
+            return (k & 1) ? 8.0 / (M_PI * M_PI * k * k) : 0.0;
+        default:
+            return k == 1 ? 1.0 : 0.0;
+    }
+}
+
+static void fft(std::vector<std::complex<double> > &x) {
+    size_t n = x.size();
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            std::swap(x[i], x[j]);
+    }
+    for (size_t length = 2; length <= n; length <<= 1) {
+        std::complex<double> step = std::polar(1.0, -2.0 * M_PI / length);
+        for (size_t i = 0; i < n; i += length) {
+            std::complex<double> w(1.0, 0.0);
+            for (size_t j = 0; j < length / 2; j++) {
+                std::complex<double> a = x[i + j];
+                std::complex<double> b = x[i + j + length / 2] * w;
+                x[i + j]              = a + b;
+                x[i + j + length / 2] = a - b;
+                w *= step;
+            }
+        }
+    }
+}
+
+static double decibels(double power_ratio) {
+    return power_ratio > 0.0 ? 10.0 * std::log10(power_ratio) : -INFINITY;
+}
+
+static quality measure(const oscillator_impl *impl, int waveform, double frequency) {
+    std::vector<float> tone(FFT_SIZE);
+    float phase     = 0.0f;
+    float increment = (float)(2.0 * M_PI * frequency / SAMPLE_RATE);
+    for (unsigned long i = 0; i < FFT_SIZE; i += BLOCK)
+        impl->render(impl, waveform, &phase, increment, tone.data() + i, BLOCK);
+
+    // 7-term Blackman-Harris: sidelobes far below float rounding noise.
+    static const double WINDOW[] = {0.27105140069342, 0.43329793923448, 0.21812299954311, 0.06592544638803,
+                                    0.01081174209837, 0.00077658482522, 0.00001388721735};
+    std::vector<std::complex<double> > spectrum(FFT_SIZE);
+    double window_power = 0.0;
+    for (unsigned long i = 0; i < FFT_SIZE; i++) {
+        double x = 2.0 * M_PI * i / FFT_SIZE;
+        double w = 0.0;
+        for (int t = 0; t < 7; t++)
+            w += ((t & 1) ? -WINDOW[t] : WINDOW[t]) * std::cos(t * x);
+        spectrum[i] = tone[i] * w;
+        window_power += w * w;
+    }
+    fft(spectrum);
+
+    std::vector<double> power(FFT_SIZE / 2);
+    std::vector<bool> harmonic(FFT_SIZE / 2, false);
+    for (unsigned long i = 0; i < FFT_SIZE / 2; i++)
+        power[i] = std::norm(spectrum[i]);
+
+    // Bin power to the power of a sinusoid, (amplitude^2) / 2.
+    double scale     = 2.0 / (FFT_SIZE * window_power);
+    double bin_hz    = (double)SAMPLE_RATE / FFT_SIZE;
+    double ideal     = 0.0;
+    double deviation = 0.0;
+    for (int k = 1; k * frequency < SAMPLE_RATE / 2.0; k++) {
+        long center = std::lround(k * frequency / bin_hz);
+        double lobe = 0.0;
+        for (long b = center - LOBE_BINS; b <= center + LOBE_BINS; b++) {
+            if (b < 1 || b >= (long)(FFT_SIZE / 2) || harmonic[b])
+                continue;
+            harmonic[b] = true;
+            lobe += power[b];
+        }
+        double amplitude = std::sqrt(2.0 * lobe * scale);
+        double error     = amplitude - ideal_harmonic(waveform, k);
+        ideal     += ideal_harmonic(waveform, k) * ideal_harmonic(waveform, k) / 2.0;
+        deviation += error * error / 2.0;
+    }
+
+    double alias = 0.0;
+    for (unsigned long b = 1 + LOBE_BINS; b < FFT_SIZE / 2; b++) {
+        if (!harmonic[b])
+            alias += power[b] * scale;
+    }
+
+    double fundamental = ideal_harmonic(waveform, 1);
+    quality q;
+    q.snr_db   = decibels(ideal / (alias + deviation));
+    q.alias_db = decibels(alias / ideal);
+    q.thd_db   = decibels(deviation / (fundamental * fundamental / 2.0));
+    return q;
+}
+
+static double cost_ns(const oscillator_impl *impl, int waveform) {
+    std::vector<float> out(BLOCK);
+    float phase     = 0.0f;
+    float increment = (float)(2.0 * M_PI * 440.0 / SAMPLE_RATE);
+    // The additive oscillator is slow enough that a shorter run will do.
+    unsigned long frames = impl->render == render_additive ? COST_FRAMES / 64 : COST_FRAMES;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long done = 0; done < frames; done += BLOCK)
+        impl->render(impl, waveform, &phase, increment, out.data(), BLOCK);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    volatile float sink = out[BLOCK - 1];
+    (void)sink;
+    return elapsed * 1e9 / frames;
+}
+
+static double note_frequency(int note) {
+    return 440.0 * std::pow(2.0, (note - 69) / 12.0);
+}
+
+int main(int argc, char **argv) {
+    bool sweep = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sweep") == 0) {
+            sweep = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--sweep]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::vector<oscillator_impl> impls;
+    impls.push_back({"reference", NULL, all_waveforms, render_reference});
+    for (int i = 0; i < DSP_ISA_COUNT; i++) {
+        const dsp_kernels *k = dsp_find(DSP_ISAS[i]);
+        if (k != NULL)
+            impls.push_back({std::string("kernel/") + DSP_ISAS[i], k, all_waveforms, render_dsp});
+    }
+    impls.push_back({"polyblep", NULL, saw_only, render_polyblep});
+    impls.push_back({"additive", NULL, saw_and_triangle, render_additive});
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::left << std::setw(16) << "oscillator" << std::setw(10) << "waveform"
+              << std::right << std::setw(8) << (sweep ? "note" : "worst") << std::setw(10) << "SNR dB"
+              << std::setw(10) << "alias dB" << std::setw(10) << "THD dB" << std::setw(12) << "ns/sample"
+              << std::endl;
+
+    for (size_t i = 0; i < impls.size(); i++) {
+        const oscillator_impl *impl = &impls[i];
+        for (int waveform = 0; waveform < 4; waveform++) {
+            if (!impl->supports(waveform))
+                continue;
+
+            double ns = cost_ns(impl, waveform);
+            quality worst = {INFINITY, -INFINITY, -INFINITY};
+            int worst_note = FIRST_NOTE;
+
+            for (int note = FIRST_NOTE; note <= LAST_NOTE; note += NOTE_STEP) {
+                quality q = measure(impl, waveform, note_frequency(note));
+                if (sweep) {
+                    std::cout << std::left << std::setw(16) << impl->name << std::setw(10) << WAVEFORM_NAMES[waveform]
+                              << std::right << std::setw(8) << note << std::setw(10) << q.snr_db
+                              << std::setw(10) << q.alias_db << std::setw(10) << q.thd_db << std::setw(12) << ns
+                              << std::endl;
+                }
+                if (q.snr_db < worst.snr_db)
+                    worst_note = note;
+                worst.snr_db   = std::min(worst.snr_db, q.snr_db);
+                worst.alias_db = std::max(worst.alias_db, q.alias_db);
+                worst.thd_db   = std::max(worst.thd_db, q.thd_db);
+            }
+
+            if (!sweep) {
+                std::cout << std::left << std::setw(16) << impl->name << std::setw(10) << WAVEFORM_NAMES[waveform]
+                          << std::right << std::setw(8) << worst_note << std::setw(10) << worst.snr_db
+                          << std::setw(10) << worst.alias_db << std::setw(10) << worst.thd_db << std::setw(12) << ns
+                          << std::endl;
+            }
+        }
+    }
+    return 0;
+}
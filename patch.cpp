@@ -0,0 +1,298 @@
+#include "patch.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+
+static const char *WAVEFORM_NAMES[] = {"sine", "saw", "square", "triangle", "string"};
+
+static const char *ARP_NAMES[] = {"off", "up", "down", "updown", "played", "random"};
+
+static const char *LFO_NAMES[] = {"sine", "triangle", "saw", "square", "random"};
+
+static const char *MOD_SOURCE_NAMES[] = {"none", "lfo1", "lfo2", "env"};
+
+static const char *MOD_TARGET_NAMES[] = {"pitch", "amp"};
+
+static const char *GRAIN_WINDOW_NAMES[] = {"hann", "gauss", "tukey", "triangle"};
+
+static const char *STRING_EXCITE_NAMES[] = {"pluck", "strike"};
+
+static std::string trim(const std::string &s) {
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+        return "";
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+static bool parse_waveform(const std::string &value, int *waveform) {
+    for (int i = 0; i < WAVEFORMS; i++) {
+        if (value == WAVEFORM_NAMES[i]) {
+            *waveform = i;
+            return true;
+        }
+    }
+    char *end;
+    long n = strtol(value.c_str(), &end, 10);
+    if (*end != '\0' || n < 0 || n >= WAVEFORMS)
+        return false;
+    *waveform = (int)n;
+    return true;
+}
+
+static bool parse_name(const std::string &value, const char *const *names, int count, int *out) {
+    for (int i = 0; i < count; i++) {
+        if (value == names[i]) {
+            *out = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_float(const std::string &value, float min, float max, float *out) {
+    char *end;
+    float f = strtof(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || !(f >= min && f <= max))
+        return false;
+    *out = f;
+    return true;
+}
+
+static bool parse_int(const std::string &value, int min, int max, int *out) {
+    char *end;
+    long n = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || n < min || n > max)
+        return false;
+    *out = (int)n;
+    return true;
+}
+
+// One character per step: `x` plays a note, `.` rests and a digit plays
+// that many ratchets.
+static bool parse_steps(const std::string &value, patch *p) {
+    if (value.empty() || value.size() > (size_t)ARP_MAX_STEPS)
+        return false;
+    for (size_t i = 0; i < value.size(); i++) {
+        char c = value[i];
+        if (c == 'x')
+            p->ratchets[i] = 1;
+        else if (c == '.')
+            p->ratchets[i] = 0;
+        else if (c >= '1' && c <= '0' + ARP_MAX_RATCHET)
+            p->ratchets[i] = (unsigned char)(c - '0');
+        else
+            return false;
+    }
+    p->steps = (int)value.size();
+    return true;
+}
+
+// `lfoN = shape rate`
+static bool parse_lfo(const std::string &value, patch *p, int lfo) {
+    std::istringstream in(value);
+    std::string shape, rate, extra;
+    if (!(in >> shape >> rate) || in >> extra)
+        return false;
+    int   s;
+    float r;
+    if (!parse_name(shape, LFO_NAMES, 5, &s) || !parse_float(rate, 0.0f, 100.0f, &r))
+        return false;
+    p->lfo_shape[lfo] = s;
+    p->lfo_rate[lfo]  = r;
+    return true;
+}
+
+// `mod_env = attack decay`
+static bool parse_mod_env(const std::string &value, patch *p) {
+    std::istringstream in(value);
+    std::string attack, decay, extra;
+    if (!(in >> attack >> decay) || in >> extra)
+        return false;
+    float a, d;
+    if (!parse_float(attack, 0.0f, 60.0f, &a) || !parse_float(decay, 0.0f, 60.0f, &d))
+        return false;
+    p->mod_attack = a;
+    p->mod_decay  = d;
+    return true;
+}
+
+// `modN = source target depth`, or `modN = none`
+static bool parse_route(const std::string &value, patch *p, int route) {
+    std::istringstream in(value);
+    std::string source, target, depth, extra;
+    mod_route r = {MOD_NONE, MOD_PITCH, 0.0f};
+    if (!(in >> source) || !parse_name(source, MOD_SOURCE_NAMES, 4, &r.source))
+        return false;
+    if (r.source != MOD_NONE) {
+        if (!(in >> target >> depth)
+            || !parse_name(target, MOD_TARGET_NAMES, 2, &r.target)
+            || !parse_float(depth, -48.0f, 48.0f, &r.depth))
+            return false;
+    }
+    if (in >> extra)
+        return false;
+    p->routes[route] = r;
+    return true;
+}
+
+void patch_defaults(patch *p) {
+    p->waveform  = 2;
+    p->amplitude = 0.5f;
+
+    p->arp      = ARP_OFF;
+    p->tempo    = 120.0f;
+    p->division = 4;
+    p->swing    = 0.0f;
+    p->gate     = 0.5f;
+    p->octaves  = 1;
+    p->steps    = 1;
+    std::fill(p->ratchets, p->ratchets + ARP_MAX_STEPS, 1);
+
+    for (int i = 0; i < MOD_LFOS; i++) {
+        p->lfo_shape[i] = LFO_SINE;
+        p->lfo_rate[i]  = 5.0f;
+    }
+    p->mod_attack = 0.01f;
+    p->mod_decay  = 0.5f;
+    for (int i = 0; i < MOD_ROUTES; i++) {
+        p->routes[i].source = MOD_NONE;
+        p->routes[i].target = MOD_PITCH;
+        p->routes[i].depth  = 0.0f;
+    }
+    p->control_period = 32;
+
+    p->grains         = 0.0f;
+    p->grain_size     = 0.08f;
+    p->grain_window   = GRAIN_HANN;
+    p->grain_position = 0.5f;
+    p->grain_spread   = 0.2f;
+    p->grain_pitch    = 0.0f;
+    p->grain_jitter   = 0.1f;
+    p->grain_mix      = 0.5f;
+
+    p->string_excite     = STRING_PLUCK;
+    p->string_decay      = 3.0f;
+    p->string_brightness = 0.5f;
+}
+
+bool patch_load(const char *path, patch *p) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error opening patch: " << path << std::endl;
+        return false;
+    }
+
+    patch next = *p;
+    std::string line;
+    int line_no = 0;
+
+    while (std::getline(file, line)) {
+        line_no++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            std::cerr << path << ":" << line_no << ": expected key = value" << std::endl;
+            return false;
+        }
+
+        std::string key   = trim(line.substr(0, eq));
+        std::string value = trim(line.substr(eq + 1));
+        if (!patch_set(&next, key, value)) {
+            std::cerr << path << ":" << line_no << ": unknown key or bad value for " << key << std::endl;
+            return false;
+        }
+    }
+
+    *p = next;
+    return true;
+}
+
+bool patch_set(patch *p, const std::string &key, const std::string &value) {
+    if (key == "waveform")
+        return parse_waveform(value, &p->waveform);
+    if (key == "amplitude")
+        return parse_float(value, 0.0f, 1.0f, &p->amplitude);
+    if (key == "arp")
+        return parse_name(value, ARP_NAMES, 6, &p->arp);
+    if (key == "tempo")
+        return parse_float(value, 20.0f, 999.0f, &p->tempo);
+    if (key == "division")
+        return parse_int(value, 1, 16, &p->division);
+    if (key == "swing")
+        return parse_float(value, 0.0f, 0.5f, &p->swing);
+    if (key == "gate")
+        return parse_float(value, 0.01f, 1.0f, &p->gate);
+    if (key == "octaves")
+        return parse_int(value, 1, 4, &p->octaves);
+    if (key == "steps")
+        return parse_steps(value, p);
+    if (key.size() == 4 && key.compare(0, 3, "lfo") == 0 && key[3] >= '1' && key[3] < '1' + MOD_LFOS)
+        return parse_lfo(value, p, key[3] - '1');
+    if (key == "mod_env")
+        return parse_mod_env(value, p);
+    if (key.size() == 4 && key.compare(0, 3, "mod") == 0 && key[3] >= '1' && key[3] < '1' + MOD_ROUTES)
+        return parse_route(value, p, key[3] - '1');
+    if (key == "control_period")
+        return parse_int(value, 1, 256, &p->control_period);
+    if (key == "grains")
+        return parse_float(value, 0.0f, 10000.0f, &p->grains);
+    if (key == "grain_size")
+        return parse_float(value, 0.005f, 1.0f, &p->grain_size);
+    if (key == "grain_window")
+        return parse_name(value, GRAIN_WINDOW_NAMES, GRAIN_WINDOWS, &p->grain_window);
+    if (key == "grain_position")
+        return parse_float(value, 0.0f, 600.0f, &p->grain_position);
+    if (key == "grain_spread")
+        return parse_float(value, 0.0f, 60.0f, &p->grain_spread);
+    if (key == "grain_pitch")
+        return parse_float(value, -48.0f, 48.0f, &p->grain_pitch);
+    if (key == "grain_jitter")
+        return parse_float(value, 0.0f, 24.0f, &p->grain_jitter);
+    if (key == "grain_mix")
+        return parse_float(value, 0.0f, 1.0f, &p->grain_mix);
+    if (key == "string_excite")
+        return parse_name(value, STRING_EXCITE_NAMES, 2, &p->string_excite);
+    if (key == "string_decay")
+        return parse_float(value, 0.05f, 60.0f, &p->string_decay);
+    if (key == "string_brightness")
+        return parse_float(value, 0.0f, 1.0f, &p->string_brightness);
+    return false;
+}
+
+void patch_bank_init(patch_bank *bank, const patch &initial) {
+    bank->current.store(new patch(initial));
+    bank->epoch.store(0);
+    bank->retired.clear();
+}
+
+void patch_publish(patch_bank *bank, const patch &next) {
+    const patch *old = bank->current.exchange(new patch(next));
+    bank->retired.push_back(std::make_pair(old, bank->epoch.load()));
+    patch_collect(bank);
+}
+
+void patch_collect(patch_bank *bank) {
+    unsigned long epoch = bank->epoch.load();
+    size_t kept = 0;
+    for (size_t i = 0; i < bank->retired.size(); i++) {
+        if (epoch > bank->retired[i].second)
+            delete bank->retired[i].first;
+        else
+            bank->retired[kept++] = bank->retired[i];
+    }
+    bank->retired.resize(kept);
+}
+
+void patch_bank_free(patch_bank *bank) {
+    for (size_t i = 0; i < bank->retired.size(); i++)
+        delete bank->retired[i].first;
+    bank->retired.clear();
+    delete bank->current.exchange(NULL);
+}
@@ -0,0 +1,134 @@
+#ifndef RASKOL_PATCH_H
+#define RASKOL_PATCH_H
+
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A patch is an immutable block of sound parameters. The control thread
+// builds a new one and publishes it with a pointer swap; the audio thread
+// only ever reads the snapshot it acquired at the start of a callback.
+
+// Waveforms 0-3 are oscillators (sine, saw, square, triangle); a string
+// patch plays every voice as a plucked or struck string instead.
+const int WAVEFORM_STRING = 4;
+const int WAVEFORMS       = 5;
+
+const int ARP_OFF    = 0;
+const int ARP_UP     = 1;
+const int ARP_DOWN   = 2;
+const int ARP_UPDOWN = 3;
+const int ARP_PLAYED = 4;
+const int ARP_RANDOM = 5;
+
+const int ARP_MAX_STEPS   = 32;
+const int ARP_MAX_RATCHET = 8;
+
+// Modulation sources, targets and LFO shapes.
+const int MOD_NONE = 0;
+const int MOD_LFO1 = 1;
+const int MOD_LFO2 = 2;
+const int MOD_ENV  = 3;
+
+const int MOD_PITCH = 0;        // depth in semitones
+const int MOD_AMP   = 1;        // depth as a gain offset
+
+const int LFO_SINE     = 0;
+const int LFO_TRIANGLE = 1;
+const int LFO_SAW      = 2;
+const int LFO_SQUARE   = 3;
+const int LFO_RANDOM   = 4;     // sample and hold, once per cycle
+
+const int MOD_LFOS   = 2;
+const int MOD_ROUTES = 4;
+
+// Grain window shapes.
+const int GRAIN_HANN     = 0;
+const int GRAIN_GAUSS    = 1;
+const int GRAIN_TUKEY    = 2;
+const int GRAIN_TRIANGLE = 3;
+const int GRAIN_WINDOWS  = 4;
+
+// String excitations.
+const int STRING_PLUCK  = 0;
+const int STRING_STRIKE = 1;
+
+typedef struct {
+    int   source;               // MOD_NONE leaves the route unused
+    int   target;
+    float depth;
+}
+mod_route;
+
+typedef struct {
+    int   waveform;
+    float amplitude;
+
+    int   arp;              // ARP_*; off plays keys directly
+    float tempo;            // beats per minute
+    int   division;         // steps per beat
+    float swing;            // delay of odd steps, fraction of a step (0-0.5)
+    float gate;             // note length, fraction of a (ratchet) step
+    int   octaves;
+    int   steps;            // pattern length
+    unsigned char ratchets[ARP_MAX_STEPS];  // notes per step; 0 is a rest
+
+    int   lfo_shape[MOD_LFOS];
+    float lfo_rate[MOD_LFOS];   // Hz
+    float mod_attack;           // modulation envelope, seconds
+    float mod_decay;
+    mod_route routes[MOD_ROUTES];
+    int   control_period;       // samples between modulation updates
+
+    float grains;               // grains per second; 0 turns the cloud off
+    float grain_size;           // seconds
+    int   grain_window;         // GRAIN_*
+    float grain_position;       // seconds back into the output, or into a loaded sample
+    float grain_spread;         // random position offset, seconds
+    float grain_pitch;          // semitones
+    float grain_jitter;         // random pitch offset, semitones
+    float grain_mix;            // 0 voices only, 1 cloud only
+
+    int   string_excite;        // STRING_*
+    float string_decay;         // seconds to -60 dB at the fundamental
+    float string_brightness;    // 0 dark to 1 bright
+}
+patch;
+
+typedef struct {
+    std::atomic<const patch*>   current;
+    std::atomic<unsigned long>  epoch;      // callbacks completed
+    std::vector<std::pair<const patch*, unsigned long> > retired;
+}
+patch_bank;
+
+void patch_defaults(patch *p);
+
+// Applies the settings in a `key = value` patch file on top of *p.
+bool patch_load(const char *path, patch *p);
+
+// Applies one setting; false for an unknown key or a bad value.
+bool patch_set(patch *p, const std::string &key, const std::string &value);
+
+void patch_bank_init(patch_bank *bank, const patch &initial);
+
+// Control thread only.
+void patch_publish(patch_bank *bank, const patch &next);
+void patch_collect(patch_bank *bank);
+
+// Frees every snapshot; the stream must be stopped.
+void patch_bank_free(patch_bank *bank);
+
+// Audio thread: bracket every callback with acquire/release. Both are
+// sequentially consistent so a retired snapshot is only reclaimed once
+// every callback that could have seen it has finished.
+inline const patch *patch_acquire(patch_bank *bank) {
+    return bank->current.load();
+}
+
+inline void patch_release(patch_bank *bank) {
+    bank->epoch.store(bank->epoch.load(std::memory_order_relaxed) + 1);
+}
+
+#endif
@@ -0,0 +1,51 @@
+#include "patch_watch.h"
+
+#include <iostream>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+bool patch_watch(patch_watcher *w, const char *path) {
+    w->path = path;
+    size_t slash = w->path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : w->path.substr(0, slash + 1);
+    w->name = slash == std::string::npos ? w->path : w->path.substr(slash + 1);
+
+    w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w->fd == -1) {
+        std::cerr << "Error creating inotify instance" << std::endl;
+        return false;
+    }
+
+    w->wd = inotify_add_watch(w->fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (w->wd == -1) {
+        std::cerr << "Error watching patch directory: " << dir << std::endl;
+        close(w->fd);
+        w->fd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool patch_watch_changed(patch_watcher *w) {
+    alignas(inotify_event) char buffer[4096];
+    bool changed = false;
+
+    for (;;) {
+        ssize_t n = read(w->fd, buffer, sizeof(buffer));
+        if (n <= 0)
+            break;
+        for (char *p = buffer; p < buffer + n; ) {
+            inotify_event *event = (inotify_event*)p;
+            if (event->len > 0 && w->name == event->name)
+                changed = true;
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
+
+void patch_unwatch(patch_watcher *w) {
+    if (w->fd != -1)
+        close(w->fd);
+    w->fd = -1;
+}
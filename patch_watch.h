@@ -0,0 +1,26 @@
+#ifndef RASKOL_PATCH_WATCH_H
+#define RASKOL_PATCH_WATCH_H
+
+#include <string>
+
+// Host side of patch hot reload: notices when the patch file is saved, so
+// the host can load it into the engine again.
+
+typedef struct {
+    int fd;
+    int wd;
+    std::string path;
+    std::string name;
+}
+patch_watcher;
+
+// Watches the patch file's directory, so editors that save by rename are
+// picked up as well as in-place writes.
+bool patch_watch(patch_watcher *w, const char *path);
+
+// Drains pending inotify events; true if the watched file changed.
+bool patch_watch_changed(patch_watcher *w);
+
+void patch_unwatch(patch_watcher *w);
+
+#endif
@@ -0,0 +1,77 @@
+#include "pcm.h"
+
+#include <algorithm>
+
+const char *const PCM_NAMES[]    = {"float32", "int32", "int24", "int16"};
+const char *const DITHER_NAMES[] = {"none", "tpdf", "shaped"};
+
+// Full scale of each format; float needs no conversion.
+static const float PCM_SCALE[] = {1.0f, 2147483648.0f, 8388608.0f, 32768.0f};
+
+void pcm_init(pcm_converter *c, int format, int channels, int dither, unsigned long chunk) {
+    c->format   = format;
+    c->channels = channels;
+    c->dither   = format == PCM_FLOAT32 ? DITHER_NONE : dither;
+    for (int j = 0; j < PCM_LANES; j++)
+        c->random[j] = 0x9e3779b9u * (uint32_t)(j + 1);
+    c->last = 0.5f;
+    unsigned long lanes = c->dither == DITHER_NONE ? 0 : (chunk + PCM_LANES - 1) / PCM_LANES * PCM_LANES;
+    c->uniform.assign(lanes, 0.0f);
+    c->noise.assign(lanes, 0.0f);
+}
+
+int pcm_bytes(int format) {
+    return format == PCM_INT16 ? 2 : (format == PCM_INT24 ? 3 : 4);
+}
+
+// xorshift32 in every lane. TPDF sums the two 16-bit halves of a draw;
+// shaped dither takes 24 bits and differences consecutive samples.
+static void make_dither(pcm_converter *c, unsigned long n) {
+    float *uniform = c->uniform.data();
+    float *noise   = c->noise.data();
+    bool   tpdf    = c->dither == DITHER_TPDF;
+    for (unsigned long i = 0; i < n; i += PCM_LANES) {
+        for (int j = 0; j < PCM_LANES; j++) {
+            uint32_t x = c->random[j];
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            c->random[j] = x;
+            uniform[i + j] = tpdf ? (float)(int)(x & 0xffff) * (1.0f / 65536.0f)
+                                    + (float)(int)(x >> 16) * (1.0f / 65536.0f) - 1.0f
+                                  : (float)(int)(x >> 8) * (1.0f / 16777216.0f);
+        }
+    }
+    if (tpdf) {
+        std::copy(uniform, uniform + n, noise);
+        return;
+    }
+    noise[0] = uniform[0] - c->last;
+    for (unsigned long i = 1; i < n; i++)
+        noise[i] = uniform[i] - uniform[i - 1];
+    c->last = uniform[n - 1];
+}
+
+void pcm_convert(pcm_converter *c, pcm_kernel convert, const float *in, void *out, unsigned long n) {
+    if (c->format == PCM_FLOAT32) {
+        float *o = (float*)out;
+        for (unsigned long i = 0; i < n; i++) {
+            for (int ch = 0; ch < c->channels; ch++)
+                o[i * c->channels + ch] = in[i];
+        }
+        return;
+    }
+
+    unsigned char *dst = (unsigned char*)out;
+    size_t frame = (size_t)pcm_bytes(c->format) * c->channels;
+    while (n > 0) {
+        unsigned long m = c->dither == DITHER_NONE ? n : std::min<unsigned long>(n, c->noise.size());
+        if (c->dither != DITHER_NONE)
+            make_dither(c, m);
+        convert(in, c->dither == DITHER_NONE ? NULL : c->noise.data(), PCM_SCALE[c->format],
+                pcm_bytes(c->format), c->channels, dst, m);
+        in  += m;
+        dst += m * frame;
+        n   -= m;
+    }
+}
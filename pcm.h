@@ -0,0 +1,54 @@
+#ifndef RASKOL_PCM_H
+#define RASKOL_PCM_H
+
+#include <cstdint>
+#include <vector>
+
+// Conversion of the engine's mono float output to what the device takes:
+// float or 32-, 24- (packed) or 16-bit integers, copied to every channel.
+// Integer formats are rounded and clipped by a convert kernel in one pass, after adding dither of up to one LSB either way:
+//
+//   tpdf    triangular, the sum of two uniform values; flat spectrum
+//   shaped  the difference of consecutive uniform values, also triangular
+//           but pushed towards Nyquist, where it is heard least
+
+const int PCM_FLOAT32 = 0;
+const int PCM_INT32   = 1;
+const int PCM_INT24   = 2;
+const int PCM_INT16   = 3;
+const int PCM_FORMATS = 4;
+
+const int DITHER_NONE   = 0;
+const int DITHER_TPDF   = 1;
+const int DITHER_SHAPED = 2;
+const int DITHERS       = 3;
+
+const int PCM_LANES = 8;        // independent generators, so the dither loop vectorises
+
+// dsp_kernels::convert, or raskol_convert for the engine's dispatched one.
+typedef void (*pcm_kernel)(const float *in, const float *dither, float scale, int bytes, int channels, void *out,
+                           unsigned long n);
+
+extern const char *const PCM_NAMES[];
+extern const char *const DITHER_NAMES[];
+
+typedef struct {
+    int format;                 // PCM_*
+    int channels;
+    int dither;                 // DITHER_*
+    uint32_t random[PCM_LANES];
+    float last;                 // previous uniform value, for shaped dither
+    std::vector<float> uniform; // one chunk, rounded up to whole lanes
+    std::vector<float> noise;   // its dither, in LSBs
+}
+pcm_converter;
+
+// Preallocates dither for `chunk` frames; longer conversions take several.
+void pcm_init(pcm_converter *c, int format, int channels, int dither, unsigned long chunk);
+
+int pcm_bytes(int format);
+
+// Audio thread: n mono frames into n interleaved device frames.
+void pcm_convert(pcm_converter *c, pcm_kernel convert, const float *in, void *out, unsigned long n);
+
+#endif
@@ -0,0 +1,279 @@
+#include "raskol.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "audio_guard.h"
+#include "control.h"
+#include "synth.h"
+#include "trace.h"
+#include "wav.h"
+
+// Output frames per resampler pass; longer renders take several.
+const unsigned long RESAMPLE_CHUNK = 512;
+
+struct raskol_engine {
+    pa_data synth;
+    int sample_rate;
+    control_socket *control;    // NULL until raskol_control_open
+};
+
+void raskol_config_defaults(raskol_config *config) {
+    config->patch_path   = NULL;
+    config->tuning       = "12tet";
+    config->keymap_path  = NULL;
+    config->graph_path   = NULL;
+    config->grain_source = NULL;
+    config->isa          = NULL;
+    config->sample_rate  = RASKOL_SAMPLE_RATE;
+    config->workers      = 0;
+    config->rt           = 0;
+    config->rt_priority  = RT_DEFAULT_PRIORITY;
+    config->rt_cpus      = NULL;
+}
+
+raskol_engine *raskol_create(const raskol_config *config) {
+    // Guard builds resolve the trapped libc calls before any callback runs.
+    audio_guard_init();
+    if (!dsp_select(config->isa)) {
+        std::cerr << "DSP kernels for " << config->isa << " are not available on this CPU" << std::endl;
+        return NULL;
+    }
+    if (config->sample_rate <= 0) {
+        std::cerr << "Bad sample rate: " << config->sample_rate << std::endl;
+        return NULL;
+    }
+
+    scale tuning_scale;
+    keyboard_map tuning_map;
+    keyboard_map_defaults(&tuning_map);
+    const char *tuning = config->tuning != NULL ? config->tuning : "12tet";
+    if (!scale_builtin(tuning, &tuning_scale) && !scale_load(tuning, &tuning_scale))
+        return NULL;
+    if (config->keymap_path != NULL && !keyboard_map_load(config->keymap_path, &tuning_map))
+        return NULL;
+
+    patch initial;
+    patch_defaults(&initial);
+    if (config->patch_path != NULL && !patch_load(config->patch_path, &initial))
+        return NULL;
+
+    std::vector<float> grain_source;
+    int grain_rate = 0;
+    if (config->grain_source != NULL && !wav_load(config->grain_source, &grain_source, &grain_rate))
+        return NULL;
+
+    graph *g = NULL;
+    if (config->graph_path != NULL && !graph_load(config->graph_path, SAMPLE_RATE, ENGINE_BLOCK, &g))
+        return NULL;
+
+    // The event queue is cache-line aligned, which plain new does not
+    // honour before C++17.
+    void *memory = NULL;
+    if (posix_memalign(&memory, alignof(raskol_engine), sizeof(raskol_engine)) != 0) {
+        graph_free(g);
+        return NULL;
+    }
+    raskol_engine *engine = new (memory) raskol_engine;
+    engine->control = NULL;
+    pa_data *data = &engine->synth;
+    synth_init(data, tuning_scale, tuning_map, initial);
+    if (config->grain_source != NULL)
+        grains_load(&data->cloud, grain_source, grain_rate, SAMPLE_RATE);
+    if (g != NULL)
+        graph_publish(&data->graphs, g);
+
+    engine->sample_rate = config->sample_rate;
+    data->resampling    = config->sample_rate != SAMPLE_RATE;
+    if (data->resampling) {
+        if (!resampler_init(&data->rate_converter, SAMPLE_RATE, config->sample_rate, RESAMPLE_CHUNK)) {
+            std::cerr << "Cannot resample " << SAMPLE_RATE << " Hz to " << config->sample_rate << " Hz" << std::endl;
+            raskol_destroy(engine);
+            return NULL;
+        }
+        data->render_buffer.resize(resampler_max_input(&data->rate_converter));
+    }
+
+    data->rt.enabled  = config->rt != 0;
+    data->rt.priority = config->rt_priority;
+    if (config->rt_cpus != NULL && !rt_parse_cpus(&data->rt, config->rt_cpus)) {
+        std::cerr << "Bad --rt-cpus list: " << config->rt_cpus << std::endl;
+        raskol_destroy(engine);
+        return NULL;
+    }
+    if (!graph_workers_start(&data->workers, config->workers, &data->rt)) {
+        raskol_destroy(engine);
+        return NULL;
+    }
+    return engine;
+}
+
+void raskol_destroy(raskol_engine *engine) {
+    if (engine->control != NULL) {
+        control_close(engine->control);
+        delete engine->control;
+    }
+    synth_free(&engine->synth);
+    engine->~raskol_engine();
+    free(engine);
+}
+
+void raskol_render(raskol_engine *engine, float *out, unsigned long frames) {
+    rt_setup_audio_thread(&engine->synth.rt);
+    synth_process(&engine->synth, out, frames);
+}
+
+void raskol_render_exact(raskol_engine *engine, float *out, unsigned long frames) {
+    synth_render(&engine->synth, out, frames);
+}
+
+int raskol_note(raskol_engine *engine, int note, int on) {
+    return synth_note(&engine->synth, note, on != 0);
+}
+
+int raskol_key(raskol_engine *engine, int code, int value) {
+    input_event event;
+    event.type  = EV_KEY;
+    event.code  = (__u16)code;
+    event.value = value;
+    return synth_input(&engine->synth, event);
+}
+
+int raskol_set(raskol_engine *engine, const char *key, const char *value) {
+    patch next = *patch_acquire(&engine->synth.patches);
+    if (!patch_set(&next, key, value)) {
+        std::cerr << "Bad setting: " << key << " = " << value << std::endl;
+        return 0;
+    }
+    patch_publish(&engine->synth.patches, next);
+    return 1;
+}
+
+int raskol_load_patch(raskol_engine *engine, const char *path) {
+    // From the defaults, so keys deleted from the file do not keep their
+    // old values; the waveform is also a keyboard choice and carries over.
+    patch next;
+    patch_defaults(&next);
+    next.waveform = patch_acquire(&engine->synth.patches)->waveform;
+    if (!patch_load(path, &next))
+        return 0;
+    patch_publish(&engine->synth.patches, next);
+    return 1;
+}
+
+int raskol_load_graph(raskol_engine *engine, const char *path) {
+    graph *g = NULL;
+    if (!graph_load(path, SAMPLE_RATE, ENGINE_BLOCK, &g))
+        return 0;
+    graph_publish(&engine->synth.graphs, g);
+    return 1;
+}
+
+void raskol_collect(raskol_engine *engine) {
+    patch_collect(&engine->synth.patches);
+    graph_collect(&engine->synth.graphs);
+}
+
+void raskol_stats_take(raskol_engine *engine, raskol_stats *stats) {
+    pa_data *data = &engine->synth;
+    stats->isa            = data->dsp->isa;
+    stats->sample_rate    = engine->sample_rate;
+    stats->event_queue    = data->events.head.load() - data->events.tail.load();
+    stats->graph_nodes    = graph_acquire(&data->graphs)->nodes.size();
+    stats->graph_workers  = data->workers.threads.size();
+    stats->idle_seconds   = raskol_idle_seconds(engine);
+
+    limiter_stats limiter;
+    if (!limiter_take_stats(&data->master, &limiter)) {
+        limiter.blocks       = 0;
+        limiter.avg_us       = 0.0;
+        limiter.max_us       = 0.0;
+        limiter.reduction_db = 0.0f;
+    }
+    stats->grains_dropped       = data->cloud.dropped.exchange(0, std::memory_order_relaxed);
+    stats->limiter_blocks       = limiter.blocks;
+    stats->limiter_avg_us       = limiter.avg_us;
+    stats->limiter_max_us       = limiter.max_us;
+    stats->limiter_reduction_db = limiter.reduction_db;
+}
+
+double raskol_idle_seconds(raskol_engine *engine) {
+    return (double)engine->synth.idle.load(std::memory_order_relaxed) / SAMPLE_RATE;
+}
+
+int raskol_pending(raskol_engine *engine) {
+    return event_queue_pending(&engine->synth.events);
+}
+
+int raskol_control_open(raskol_engine *engine, const char *path) {
+    if (engine->control == NULL) {
+        engine->control = new control_socket;
+        engine->control->fd = -1;
+    }
+    control_close(engine->control);
+    return control_open(engine->control, path);
+}
+
+int raskol_control_fd(raskol_engine *engine) {
+    return engine->control != NULL ? engine->control->fd : -1;
+}
+
+int raskol_control_poll(raskol_engine *engine) {
+    if (engine->control == NULL || engine->control->fd == -1)
+        return 1;
+    return control_poll(engine->control, &engine->synth);
+}
+
+void raskol_control_share(raskol_engine *engine, int fd) {
+    if (engine->control != NULL)
+        engine->control->share_fd = fd;
+}
+
+void raskol_rt_setup(raskol_engine *engine) {
+    rt_setup_process(&engine->synth.rt);
+    rt_setup_input_thread(&engine->synth.rt);
+}
+
+void raskol_rt_restart(raskol_engine *engine) {
+    rt_restart_audio(&engine->synth.rt);
+}
+
+void raskol_rt_report(raskol_engine *engine) {
+    rt_report_audio(&engine->synth.rt);
+}
+
+void raskol_convert(const float *in, const float *dither, float scale, int bytes, int channels, void *out,
+                    unsigned long n) {
+    dsp_active()->convert(in, dither, scale, bytes, channels, out, n);
+}
+
+void raskol_trace_start(void) {
+    trace_init();
+}
+
+void raskol_trace_thread(const char *name) {
+    trace_thread(name);
+}
+
+uint64_t raskol_trace_ticks(void) {
+    return trace_enabled ? trace_ticks() : 0;
+}
+
+void raskol_trace_span(const char *name, uint64_t begin, uint32_t arg) {
+    if (trace_enabled && begin != 0)
+        trace_record(name, begin, trace_ticks(), arg);
+}
+
+int raskol_trace_write(const char *path) {
+    return trace_write(path);
+}
+
+void raskol_guard_enter(void) {
+    audio_guard_enter();
+}
+
+void raskol_guard_leave(void) {
+    audio_guard_leave();
+}
@@ -0,0 +1,182 @@
+#ifndef RASKOL_H
+#define RASKOL_H
+
+// C API of libraskol: the engine behind an opaque handle, for hosts that
+// render it from their own audio callback instead of running `main`.
+//
+// One thread renders (the host's audio thread); everything else is called
+// from one control thread. Events and settings take effect at the next
+// engine block rendered. Functions returning int return 1 on success and
+// 0 on failure; the reason goes to stderr. Only these raskol_* symbols are
+// exported from the shared library.
+//
+//   raskol_config config;
+//   raskol_config_defaults(&config);
+//   config.sample_rate = 48000;
+//   raskol_engine *engine = raskol_create(&config);
+//   raskol_note(engine, 60, 1);
+//   raskol_render(engine, out, frames);      // from the audio callback
+//   raskol_destroy(engine);                  // once rendering has stopped
+
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define RASKOL_API __attribute__((visibility("default")))
+#else
+#define RASKOL_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RASKOL_SAMPLE_RATE 44100    // the engine's own rate
+
+typedef struct raskol_engine raskol_engine;
+
+typedef struct {
+    const char *patch_path;     // NULL for the default patch
+    const char *tuning;         // built-in name or Scala file
+    const char *keymap_path;    // Scala keyboard mapping, or NULL
+    const char *graph_path;     // NULL for voices into grains
+    const char *grain_source;   // WAV for the grain cloud, or NULL
+    const char *isa;            // DSP kernel level, NULL for the best one
+    int sample_rate;            // output rate; anything but RASKOL_SAMPLE_RATE is resampled
+    int workers;                // graph worker threads, 0 to 8
+    int rt;                     // real-time hardening, see --rt
+    int rt_priority;
+    const char *rt_cpus;        // "audio,input[,worker]", or NULL
+}
+raskol_config;
+
+typedef struct {
+    const char *isa;
+    int    sample_rate;         // output rate
+    unsigned long event_queue;  // events not yet applied
+    unsigned long graph_nodes;
+    unsigned long graph_workers;
+    double idle_seconds;
+
+    // Since the previous call; limiter_blocks is 0 if nothing rendered.
+    unsigned long grains_dropped;
+    unsigned long limiter_blocks;
+    double limiter_avg_us;
+    double limiter_max_us;
+    float  limiter_reduction_db;
+}
+raskol_stats;
+
+RASKOL_API void raskol_config_defaults(raskol_config *config);
+
+// NULL if a file does not load or a setting is invalid.
+RASKOL_API raskol_engine *raskol_create(const raskol_config *config);
+
+// Rendering must have stopped.
+RASKOL_API void raskol_destroy(raskol_engine *engine);
+
+// Audio thread: `frames` samples at the output rate. With rt on, the first
+// call sets up the calling thread.
+RASKOL_API void raskol_render(raskol_engine *engine, float *out, unsigned long frames);
+
+// Offline, at RASKOL_SAMPLE_RATE: events pushed between calls land on the
+// first sample of the next one, so a host can place them exactly by
+// splitting its renders at them.
+RASKOL_API void raskol_render_exact(raskol_engine *engine, float *out, unsigned long frames);
+
+// MIDI note through the tuning. 0 if it is unmapped or the event queue is
+// full.
+RASKOL_API int raskol_note(raskol_engine *engine, int note, int on);
+
+// An evdev key event (EV_KEY code and value) as from the keyboard, waveform
+// keys included. 0 for the quit key.
+RASKOL_API int raskol_key(raskol_engine *engine, int code, int value);
+
+// Any patch file key, e.g. raskol_set(engine, "waveform", "saw").
+RASKOL_API int raskol_set(raskol_engine *engine, const char *key, const char *value);
+
+// Replaces the settings with a patch file's; keys it leaves out take their
+// defaults. The waveform, which the keyboard also selects, is kept unless
+// the file sets one.
+RASKOL_API int raskol_load_patch(raskol_engine *engine, const char *path);
+
+// Compiles a graph file and swaps it in.
+RASKOL_API int raskol_load_graph(raskol_engine *engine, const char *path);
+
+// Frees the patches and graphs the audio thread has moved past. Call it
+// now and then.
+RASKOL_API void raskol_collect(raskol_engine *engine);
+
+RASKOL_API void raskol_stats_take(raskol_engine *engine, raskol_stats *stats);
+
+// Any thread: seconds the engine has been idle, 0 while it renders sound.
+// A host may stop its stream after a while; see raskol_pending.
+RASKOL_API double raskol_idle_seconds(raskol_engine *engine);
+
+// 1 while pushed events wait for the next render.
+RASKOL_API int raskol_pending(raskol_engine *engine);
+
+// Control socket taking the commands of --control (see README.md),
+// polled from the control thread. raskol_control_poll handles every queued datagram and returns 0
+// once one asked to quit; raskol_destroy closes the socket.
+RASKOL_API int raskol_control_open(raskol_engine *engine, const char *path);
+RASKOL_API int raskol_control_fd(raskol_engine *engine);     // -1 if not open
+RASKOL_API int raskol_control_poll(raskol_engine *engine);
+
+// File descriptor the `share` command passes on, -1 for none.
+RASKOL_API void raskol_control_share(raskol_engine *engine, int fd);
+
+// Real-time hardening with config.rt on; no-ops otherwise. Control thread.
+// Setup locks and prefaults memory and hardens the calling thread, before
+// the stream starts. Restart, with the stream stopped, lets the audio
+// thread of a restarted stream set itself up again. Report prints the
+// audio thread's results once they are in; call it now and then.
+RASKOL_API void raskol_rt_setup(raskol_engine *engine);
+RASKOL_API void raskol_rt_restart(raskol_engine *engine);
+RASKOL_API void raskol_rt_report(raskol_engine *engine);
+
+// The dispatched integer PCM kernel: in[i] * scale + dither[i] (dither may
+// be NULL) rounded, clamped to [-scale, scale) and written to `channels`
+// interleaved little-endian slots of `bytes` (2, 3 or 4) bytes each. Any
+// thread, once an engine has been created.
+RASKOL_API void raskol_convert(const float *in, const float *dither, float scale, int bytes, int channels,
+                               void *out, unsigned long n);
+
+// Timeline tracing (--trace), process-wide. Start turns it on; call it
+// before creating engines or starting threads. Hosts add their own spans:
+// begin with raskol_trace_ticks(), which is 0 while tracing is off, and end
+// with raskol_trace_span(); `name` must outlive the trace.
+RASKOL_API void raskol_trace_start(void);
+RASKOL_API void raskol_trace_thread(const char *name);
+RASKOL_API uint64_t raskol_trace_ticks(void);
+RASKOL_API void raskol_trace_span(const char *name, uint64_t begin, uint32_t arg);
+RASKOL_API int raskol_trace_write(const char *path);
+
+// Builds configured with RASKOL_AUDIO_GUARD trap allocations and blocking
+// calls made inside raskol_render. A host brackets the rest of its audio
+// callback with these to have its own code checked as well; they nest.
+// No-ops in other builds.
+RASKOL_API void raskol_guard_enter(void);
+RASKOL_API void raskol_guard_leave(void);
+
+#ifdef __cplusplus
+}
+
+// The guard for the lifetime of the scope.
+struct raskol_guard_scope {
+    raskol_guard_scope() { raskol_guard_enter(); }
+    ~raskol_guard_scope() { raskol_guard_leave(); }
+};
+
+// A host span for the lifetime of the scope.
+struct raskol_trace_scope {
+    const char *name;
+    uint64_t begin;
+    uint32_t arg;
+
+    explicit raskol_trace_scope(const char *span, uint32_t value = 0)
+        : name(span), begin(raskol_trace_ticks()), arg(value) {}
+    ~raskol_trace_scope() { raskol_trace_span(name, begin, arg); }
+};
+#endif
+
+#endif
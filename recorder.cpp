@@ -0,0 +1,161 @@
+#include "recorder.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "raskol.h"
+#include "wav.h"
+
+static bool write_all(int fd, const void *buf, size_t size, off_t offset) {
+    const char *p = (const char*)buf;
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p      += n;
+        size   -= n;
+        offset += n;
+    }
+    return true;
+}
+
+static off_t data_offset(const recorder *r) {
+    return (off_t)(RECORDER_ALIGN + r->frames * sizeof(float));
+}
+
+static void flush_staging(recorder *r) {
+    if (r->staged == 0)
+        return;
+    raskol_trace_scope span("write", r->staged);
+    if (!r->failed && !write_all(r->fd, r->staging, r->staged * sizeof(float), data_offset(r))) {
+        std::cerr << "Recording: error writing " << r->path << ": " << strerror(errno) << std::endl;
+        r->failed = true;
+    }
+    r->frames += r->staged;
+    r->staged  = 0;
+}
+
+// Moves whatever the ring holds into the staging buffer, writing every
+// chunk that fills up. Returns the number of samples taken.
+static size_t drain(recorder *r) {
+    size_t tail  = r->tail.load(std::memory_order_relaxed);
+    size_t head  = r->head.load(std::memory_order_acquire);
+    size_t taken = head - tail;
+
+    while (tail != head) {
+        size_t offset = tail & (RECORDER_RING - 1);
+        size_t n = std::min(std::min(head - tail, RECORDER_RING - offset), RECORDER_CHUNK - r->staged);
+        memcpy(r->staging + r->staged, r->ring.data() + offset, n * sizeof(float));
+        r->staged += n;
+        tail      += n;
+        r->tail.store(tail, std::memory_order_release);
+        if (r->staged == RECORDER_CHUNK)
+            flush_staging(r);
+    }
+    return taken;
+}
+
+static void writer_loop(recorder *r) {
+    timespec pause = {0, RECORDER_POLL_MS * 1000000L};
+    raskol_trace_thread("recorder");
+    while (true) {
+        bool stopping = r->stop.load();
+        if (drain(r) == 0) {
+            if (stopping)
+                break;
+            nanosleep(&pause, NULL);
+        }
+    }
+
+    // The last partial chunk is not block sized.
+    if (r->direct)
+        fcntl(r->fd, F_SETFL, fcntl(r->fd, F_GETFL) & ~O_DIRECT);
+    flush_staging(r);
+}
+
+bool recorder_start(recorder *r, const char *path, int sample_rate, bool direct) {
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    r->fd = direct ? open(path, flags | O_DIRECT, 0644) : -1;
+    r->direct = r->fd != -1;
+    if (r->fd == -1)
+        r->fd = open(path, flags, 0644);
+    if (r->fd == -1) {
+        std::cerr << "Error creating " << path << std::endl;
+        return false;
+    }
+
+    void *staging = NULL;
+    if (posix_memalign(&staging, RECORDER_ALIGN, RECORDER_CHUNK * sizeof(float)) != 0) {
+        close(r->fd);
+        return false;
+    }
+
+    r->path        = path;
+    r->staging     = (float*)staging;
+    r->staged      = 0;
+    r->frames      = 0;
+    r->failed      = false;
+    r->sample_rate = sample_rate;
+
+    // The header takes a whole block so the samples stay aligned.
+    wav_fill_header((unsigned char*)r->staging, RECORDER_ALIGN, sample_rate, 1, 0);
+    if (!write_all(r->fd, r->staging, RECORDER_ALIGN, 0)) {
+        std::cerr << "Error writing " << path << std::endl;
+        free(r->staging);
+        close(r->fd);
+        return false;
+    }
+
+    r->ring.assign(RECORDER_RING, 0.0f);
+    r->head.store(0);
+    r->tail.store(0);
+    r->dropped.store(0);
+    r->stop.store(false);
+    r->writer = std::thread(writer_loop, r);
+
+    std::cerr << "Recording to " << path << (r->direct ? " (O_DIRECT)" : "") << std::endl;
+    return true;
+}
+
+void recorder_push(recorder *r, const float *samples, unsigned long n) {
+    size_t head = r->head.load(std::memory_order_relaxed);
+    size_t tail = r->tail.load(std::memory_order_acquire);
+    size_t room = RECORDER_RING - (head - tail);
+    if (n > room) {
+        r->dropped.fetch_add(n - room, std::memory_order_relaxed);
+        n = room;
+    }
+
+    size_t offset = head & (RECORDER_RING - 1);
+    size_t first  = std::min((size_t)n, RECORDER_RING - offset);
+    memcpy(r->ring.data() + offset, samples, first * sizeof(float));
+    memcpy(r->ring.data(), samples + first, (n - first) * sizeof(float));
+    r->head.store(head + n, std::memory_order_release);
+}
+
+unsigned long recorder_take_dropped(recorder *r) {
+    return r->dropped.exchange(0);
+}
+
+bool recorder_stop(recorder *r) {
+    r->stop.store(true);
+    r->writer.join();
+
+    // The header block was written with the data size unknown.
+    unsigned char header[RECORDER_ALIGN];
+    wav_fill_header(header, sizeof(header), r->sample_rate, 1, r->frames);
+    bool ok = !r->failed && write_all(r->fd, header, sizeof(header), 0);
+    ok = close(r->fd) == 0 && ok;
+    free(r->staging);
+
+    std::cerr << "Recorded " << r->frames << " frames to " << r->path << std::endl;
+    return ok;
+}
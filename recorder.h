@@ -0,0 +1,55 @@
+#ifndef RASKOL_RECORDER_H
+#define RASKOL_RECORDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records the output stream to a float WAV. The audio thread copies each
+// block into a single-producer single-consumer ring; a writer thread drains
+// it in large block-aligned writes. A full ring drops samples and counts
+// them rather than ever making the audio thread wait.
+
+const size_t RECORDER_RING     = 1 << 20;     // samples, power of two
+const size_t RECORDER_CHUNK    = 1 << 16;     // samples per write
+const size_t RECORDER_ALIGN    = 4096;
+const int    RECORDER_POLL_MS  = 20;
+
+typedef struct {
+    std::vector<float> ring;
+    alignas(64) std::atomic<size_t> head;   // next sample the audio thread writes
+    alignas(64) std::atomic<size_t> tail;   // next sample the writer reads
+    std::atomic<unsigned long> dropped;
+    std::atomic<bool> stop;
+
+    // Writer thread only.
+    std::thread writer;
+    std::string path;
+    int   fd;
+    bool  direct;               // O_DIRECT until the final partial write
+    bool  failed;
+    int   sample_rate;
+    float *staging;             // RECORDER_CHUNK samples, RECORDER_ALIGN aligned
+    size_t staged;
+    uint64_t frames;
+}
+recorder;
+
+// Creates the file and starts the writer thread. `direct` asks for O_DIRECT
+// and quietly falls back when the filesystem refuses it.
+bool recorder_start(recorder *r, const char *path, int sample_rate, bool direct);
+
+// Audio thread: never blocks or allocates.
+void recorder_push(recorder *r, const float *samples, unsigned long n);
+
+// Control thread: samples dropped since the last call.
+unsigned long recorder_take_dropped(recorder *r);
+
+// Drains the ring, finishes the header and closes the file. The stream
+// must be stopped.
+bool recorder_stop(recorder *r);
+
+#endif
@@ -0,0 +1,127 @@
+#include "resampler.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "kernels.h"
+
+static const double KAISER_BETA = 8.6;     // about 86 dB of stopband rejection
+
+static long gcd(long a, long b) {
+    while (b != 0) {
+        long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static double bessel_i0(double x) {
+    double sum  = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+bool resampler_init(resampler *r, int in_rate, int out_rate, unsigned long max_out_frames) {
+    if (in_rate <= 0 || out_rate <= 0 || max_out_frames == 0)
+        return false;
+
+    long g = gcd(in_rate, out_rate);
+    r->in_rate  = in_rate;
+    r->out_rate = out_rate;
+    r->taps     = RESAMPLER_TAPS;
+    r->dot      = dsp_active()->dot;
+    r->num      = in_rate / g;
+    r->den      = out_rate / g;
+    r->exact    = r->den <= RESAMPLER_MAX_PHASES;
+    r->phases   = r->exact ? (int)r->den : RESAMPLER_MAX_PHASES;
+    r->max_out  = max_out_frames;
+
+    // Kaiser's estimate of the window's transition band, as a fraction of
+    // the input Nyquist. The cutoff sits half of it below the lower of the
+    // two Nyquist rates, so the stopband starts there and neither images
+    // nor aliases fold back.
+    double rejection  = KAISER_BETA / 0.1102 + 8.7;
+    double transition = (rejection - 7.95) / (2.285 * M_PI * (r->taps - 1));
+    double cutoff     = std::min(1.0, (double)out_rate / in_rate) - transition / 2.0;
+    int    half       = r->taps / 2;
+    double i0b    = bessel_i0(KAISER_BETA);
+
+    r->coeffs.assign((size_t)(r->phases + 1) * r->taps, 0.0f);
+    for (int p = 0; p <= r->phases; p++) {
+        float *row = &r->coeffs[(size_t)p * r->taps];
+        double f   = (double)p / r->phases;
+        double sum = 0.0;
+        for (int k = 0; k < r->taps; k++) {
+            double x = k - (half - 1) - f;
+            double s = x == 0.0 ? 1.0 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+            double t = x / half;
+            double w = std::fabs(t) >= 1.0 ? 0.0 : bessel_i0(KAISER_BETA * sqrt(1.0 - t * t)) / i0b;
+            row[k] = (float)(s * w);
+            sum += row[k];
+        }
+        for (int k = 0; k < r->taps; k++)
+            row[k] = (float)(row[k] / sum);
+    }
+
+    r->history.assign(r->taps + resampler_max_input(r), 0.0f);
+    resampler_reset(r);
+    return true;
+}
+
+void resampler_reset(resampler *r) {
+    std::fill(r->history.begin(), r->history.end(), 0.0f);
+    r->pos  = 0;
+    r->frac = 0;
+    r->fill = r->taps / 2 - 1;
+}
+
+unsigned long resampler_input_needed(const resampler *r, unsigned long out_frames) {
+    if (out_frames == 0)
+        return 0;
+    size_t last = r->pos + (size_t)((r->frac + (long)(out_frames - 1) * r->num) / r->den);
+    size_t need = last + r->taps;
+    return need > r->fill ? (unsigned long)(need - r->fill) : 0;
+}
+
+unsigned long resampler_max_input(const resampler *r) {
+    return (unsigned long)(((long)r->max_out * r->num) / r->den) + r->taps + 1;
+}
+
+void resampler_process(resampler *r, const float *in, unsigned long in_frames,
+                       float *out, unsigned long out_frames) {
+    std::memcpy(&r->history[r->fill], in, in_frames * sizeof(float));
+    r->fill += in_frames;
+
+    const float *h = r->history.data();
+    const float *c = r->coeffs.data();
+
+    for (unsigned long i = 0; i < out_frames; i++) {
+        if (r->exact) {
+            *out++ = r->dot(h + r->pos, c + (size_t)r->frac * r->taps, r->taps);
+        } else {
+            float row  = (float)r->frac * r->phases / r->den;
+            int   p    = (int)row;
+            float mix  = row - p;
+            float a    = r->dot(h + r->pos, c + (size_t)p * r->taps, r->taps);
+            float b    = r->dot(h + r->pos, c + (size_t)(p + 1) * r->taps, r->taps);
+            *out++ = a + (b - a) * mix;
+        }
+
+        r->frac += r->num;
+        r->pos  += r->frac / r->den;
+        r->frac %= r->den;
+    }
+
+    size_t keep = r->fill - r->pos;
+    std::memmove(&r->history[0], &r->history[r->pos], keep * sizeof(float));
+    r->fill = keep;
+    r->pos  = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef RASKOL_RESAMPLER_H
+#define RASKOL_RESAMPLER_H
+
+#include <cstddef>
+#include <vector>
+
+// Streaming polyphase windowed-sinc resampler. The filter bank holds one
+// row of `taps` coefficients per phase; ratios whose reduced denominator
+// fits the bank are exact, anything else interpolates between rows.
+
+const int RESAMPLER_TAPS       = 64;
+const int RESAMPLER_MAX_PHASES = 1024;
+
+typedef struct {
+    int   in_rate;
+    int   out_rate;
+    int   taps;
+    int   phases;
+    long  num;          // input advance per output sample, in 1/den units
+    long  den;
+    long  frac;         // position between history[pos] and history[pos + 1]
+    bool  exact;
+    std::vector<float> coeffs;
+    std::vector<float> history;
+    size_t pos;
+    size_t fill;
+    unsigned long max_out;
+    float (*dot)(const float *a, const float *b, int n);    // dsp_active() at init
+}
+resampler;
+
+bool resampler_init(resampler *r, int in_rate, int out_rate, unsigned long max_out_frames);
+
+void resampler_reset(resampler *r);
+
+// Input frames the next resampler_process() call must be given to produce
+// out_frames of output.
+unsigned long resampler_input_needed(const resampler *r, unsigned long out_frames);
+
+unsigned long resampler_max_input(const resampler *r);
+
+void resampler_process(resampler *r, const float *in, unsigned long in_frames,
+                       float *out, unsigned long out_frames);
+
+#endif
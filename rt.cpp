@@ -0,0 +1,192 @@
+#include "rt.h"
+
+#include <iostream>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#include <pmmintrin.h>
+#endif
+
+static void report(const char *what, int error) {
+    if (error == 0)
+        std::cerr << "RT: " << what << ": ok" << std::endl;
+    else
+        std::cerr << "RT: " << what << ": failed: " << strerror(error) << std::endl;
+}
+
+static int pin_current_thread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static void prefault_stack() {
+    volatile unsigned char stack[RT_PREFAULT_STACK];
+    for (size_t i = 0; i < sizeof(stack); i += 4096)
+        stack[i] = 0;
+}
+
+void rt_defaults(rt_mode *rt) {
+    rt->enabled     = false;
+    rt->priority    = RT_DEFAULT_PRIORITY;
+    rt->audio_cpu   = -1;
+    rt->input_cpu   = -1;
+    rt->worker_cpu  = -1;
+    rt->audio_ready = false;
+    rt->audio_done.store(false);
+    rt->audio_pin_error.store(0);
+    rt->audio_denormals.store(false);
+    rt->audio_priority.store(0);
+    rt->reported    = false;
+}
+
+bool rt_parse_cpus(rt_mode *rt, const char *list) {
+    int *cpus[] = {&rt->audio_cpu, &rt->input_cpu, &rt->worker_cpu};
+    const char *p = list;
+
+    for (int i = 0; i < 3 && *p != '\0'; i++) {
+        char *end;
+        long cpu = strtol(p, &end, 10);
+        if (end == p || cpu < 0 || cpu >= CPU_SETSIZE)
+            return false;
+        *cpus[i] = (int)cpu;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return *p == '\0';
+}
+
+void rt_setup_process(rt_mode *rt) {
+    if (!rt->enabled)
+        return;
+
+    // Keep freed heap mapped so later allocations never fault or call mmap.
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+        report("lock memory", 0);
+    } else {
+        report("lock memory", errno);
+        std::cerr << "RT: raise RLIMIT_MEMLOCK (ulimit -l) or grant CAP_IPC_LOCK" << std::endl;
+    }
+
+    char *heap = (char*)malloc(RT_PREFAULT_HEAP);
+    if (heap != NULL) {
+        for (size_t i = 0; i < RT_PREFAULT_HEAP; i += 4096)
+            heap[i] = 0;
+        free(heap);
+    }
+    prefault_stack();
+}
+
+void rt_setup_input_thread(rt_mode *rt) {
+    if (!rt->enabled)
+        return;
+
+    sched_param param;
+    param.sched_priority = rt->priority;
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    report("SCHED_FIFO for input thread", error);
+    if (error == EPERM)
+        std::cerr << "RT: needs CAP_SYS_NICE or an rtprio limit (ulimit -r)" << std::endl;
+
+    if (rt->input_cpu >= 0)
+        report("pin input thread", pin_current_thread(rt->input_cpu));
+}
+
+void rt_setup_audio_thread(rt_mode *rt) {
+    if (!rt->enabled || rt->audio_ready)
+        return;
+    rt->audio_ready = true;
+
+#if defined(__SSE__)
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+    _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+    rt->audio_denormals.store(true);
+#endif
+
+    if (rt->audio_cpu >= 0)
+        rt->audio_pin_error.store(pin_current_thread(rt->audio_cpu));
+
+    // The host sets this thread's priority; graph workers follow it.
+    int policy;
+    sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) == 0)
+        rt->audio_priority.store(policy == SCHED_FIFO || policy == SCHED_RR ? param.sched_priority : 0);
+    prefault_stack();
+    rt->audio_done.store(true);
+}
+
+void rt_restart_audio(rt_mode *rt) {
+    rt->audio_ready = false;
+    rt->audio_done.store(false);
+    rt->audio_pin_error.store(0);
+    rt->reported = false;
+}
+
+void rt_setup_worker_thread(rt_mode *rt, int index, int *priority) {
+    *priority = 0;
+    if (!rt->enabled)
+        return;
+
+#if defined(__SSE__)
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+    _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+#endif
+
+    // A preempted SCHED_OTHER worker would stall the audio thread, whose
+    // sched_yield does not hand the CPU to it. Until a callback records the
+    // audio thread's priority, the input thread's.
+    sched_param param;
+    param.sched_priority = rt->priority;
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error != 0)
+        std::cerr << "RT: SCHED_FIFO for graph worker " << index << ": failed: " << strerror(error) << std::endl;
+    else
+        *priority = rt->priority;
+
+    if (rt->worker_cpu < 0)
+        return;
+    int cpu = rt->worker_cpu + index;
+    if (cpu == rt->audio_cpu) {
+        // Below the audio thread on its own core, the worker would never
+        // run while the audio thread waits for it.
+        std::cerr << "RT: pin graph worker " << index << ": not on the audio core " << cpu << std::endl;
+        return;
+    }
+    error = pin_current_thread(cpu);
+    if (error != 0)
+        std::cerr << "RT: pin graph worker " << index << ": failed: " << strerror(error) << std::endl;
+}
+
+void rt_follow_audio(rt_mode *rt, int *priority) {
+    int audio = rt->audio_priority.load(std::memory_order_relaxed);
+    if (*priority == 0 || audio <= 1 || audio - 1 == *priority)
+        return;
+    *priority = audio - 1;
+    sched_param param;
+    param.sched_priority = *priority;
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+}
+
+void rt_report_audio(rt_mode *rt) {
+    if (!rt->enabled || rt->reported || !rt->audio_done.load())
+        return;
+    rt->reported = true;
+
+    if (rt->audio_denormals.load())
+        report("flush denormals on audio thread", 0);
+    else
+        std::cerr << "RT: flush denormals on audio thread: not supported on this CPU" << std::endl;
+
+    if (rt->audio_cpu >= 0)
+        report("pin audio thread", rt->audio_pin_error.load());
+}
@@ -0,0 +1,60 @@
+#ifndef RASKOL_RT_H
+#define RASKOL_RT_H
+
+#include <atomic>
+#include <cstddef>
+
+// Opt-in real-time hardening. Process and input-thread settings are applied
+// and reported from the control thread; the audio thread applies its own on
+// the first callback and leaves the result for the control thread to report.
+
+const int    RT_DEFAULT_PRIORITY = 70;
+const size_t RT_PREFAULT_STACK   = 256 * 1024;
+const size_t RT_PREFAULT_HEAP    = 4 * 1024 * 1024;
+
+typedef struct {
+    bool enabled;
+    int  priority;          // SCHED_FIFO priority of the input thread
+    int  audio_cpu;         // -1 leaves the thread unpinned
+    int  input_cpu;
+    int  worker_cpu;        // first core for worker threads
+
+    bool audio_ready;       // audio thread only
+    std::atomic<bool> audio_done;
+    std::atomic<int>  audio_pin_error;
+    std::atomic<bool> audio_denormals;
+    std::atomic<int>  audio_priority;   // SCHED_FIFO/RR priority of the audio thread, 0 if none
+    bool reported;
+}
+rt_mode;
+
+void rt_defaults(rt_mode *rt);
+
+// Parses "audio,input[,worker]" core numbers.
+bool rt_parse_cpus(rt_mode *rt, const char *list);
+
+// Locks and prefaults memory. Call before the stream starts.
+void rt_setup_process(rt_mode *rt);
+
+void rt_setup_input_thread(rt_mode *rt);
+
+// Called at the top of every callback; does its work once.
+void rt_setup_audio_thread(rt_mode *rt);
+
+// Control thread, with the stream stopped: a restarted stream may call back
+// on a new thread, which then sets itself up again and is reported anew.
+void rt_restart_audio(rt_mode *rt);
+
+// Graph worker threads: flushes denormals, pins, and runs the worker under
+// SCHED_FIFO, since the audio thread waits on its nodes. Reports what it
+// could not apply. *priority is the worker's own, for rt_follow_audio.
+void rt_setup_worker_thread(rt_mode *rt, int index, int *priority);
+
+// Graph worker threads, on every wake: moves the worker to one below the
+// audio thread's priority once a callback has recorded it.
+void rt_follow_audio(rt_mode *rt, int *priority);
+
+// Prints the audio thread's results once they are in. Control thread only.
+void rt_report_audio(rt_mode *rt);
+
+#endif
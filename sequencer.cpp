@@ -0,0 +1,142 @@
+#include "sequencer.h"
+
+#include <cmath>
+#include <algorithm>
+
+void sequencer_init(sequencer *s) {
+    wheel_init(&s->wheel);
+    s->held_count = 0;
+    s->running    = false;
+    s->grid       = 0.0;
+    s->step       = 0;
+    s->note_index = 0;
+    s->random     = 0x9e3779b9u;
+}
+
+void sequencer_hold(sequencer *s, int key, float frequency, float phase_increment, uint64_t now) {
+    for (int i = 0; i < s->held_count; i++) {
+        if (s->held_key[i] == key)
+            return;
+    }
+    if (s->held_count == ARP_MAX_HELD)
+        return;
+
+    s->held_key[s->held_count]       = key;
+    s->held_frequency[s->held_count] = frequency;
+    s->held_increment[s->held_count] = phase_increment;
+    s->held_count++;
+
+    if (s->running)
+        return;
+
+    wheel_entry e;
+    e.time = now;
+    e.type = SEQ_STEP;
+    if (wheel_schedule(&s->wheel, e)) {
+        s->running    = true;
+        s->grid       = (double)now;
+        s->step       = 0;
+        s->note_index = 0;
+    }
+}
+
+void sequencer_release(sequencer *s, int key) {
+    for (int i = 0; i < s->held_count; i++) {
+        if (s->held_key[i] != key)
+            continue;
+        for (int j = i + 1; j < s->held_count; j++) {
+            s->held_key[j - 1]       = s->held_key[j];
+            s->held_frequency[j - 1] = s->held_frequency[j];
+            s->held_increment[j - 1] = s->held_increment[j];
+        }
+        s->held_count--;
+        return;
+    }
+}
+
+// Held keys sorted by pitch, as indices into the held arrays.
+static void sort_by_pitch(const sequencer *s, int *order) {
+    for (int i = 0; i < s->held_count; i++) {
+        int j = i;
+        while (j > 0 && s->held_frequency[order[j - 1]] > s->held_frequency[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+}
+
+static int pick(sequencer *s, const patch *p, int *octave) {
+    int count  = s->held_count;
+    int length = count * p->octaves;
+    int order[ARP_MAX_HELD];
+    int k;
+
+    switch (p->arp) {
+        case ARP_DOWN:
+            k = length - 1 - (int)(s->note_index % length);
+            break;
+        case ARP_UPDOWN:
+            if (length < 2) {
+                k = 0;
+            } else {
+                int period = 2 * length - 2;
+                k = (int)(s->note_index % period);
+                if (k >= length)
+                    k = period - k;
+            }
+            break;
+        case ARP_RANDOM:
+            s->random ^= s->random << 13;
+            s->random ^= s->random >> 17;
+            s->random ^= s->random << 5;
+            k = (int)(s->random % (uint32_t)length);
+            break;
+        default:
+            k = (int)(s->note_index % length);
+            break;
+    }
+
+    *octave = k / count;
+    if (p->arp == ARP_PLAYED)
+        return k % count;
+    sort_by_pitch(s, order);
+    return order[k % count];
+}
+
+void sequencer_step(sequencer *s, const patch *p, int sample_rate, uint64_t now) {
+    if (s->held_count == 0 || p->arp == ARP_OFF) {
+        s->running = false;
+        return;
+    }
+
+    double length  = sample_rate * 60.0 / (p->tempo * p->division);
+    int    ratchet = p->ratchets[s->step % p->steps];
+
+    if (ratchet > 0) {
+        int octave;
+        int held = pick(s, p, &octave);
+        float scale = (float)(1 << octave);
+        double sub  = length / ratchet;
+
+        for (int r = 0; r < ratchet; r++) {
+            wheel_entry e;
+            e.time            = now + (uint64_t)std::llround(r * sub);
+            e.type            = SEQ_NOTE_ON;
+            e.frequency       = s->held_frequency[held] * scale;
+            e.phase_increment = s->held_increment[held] * scale;
+            e.duration        = (uint32_t)std::max(1.0, std::floor(p->gate * sub));
+            wheel_schedule(&s->wheel, e);
+        }
+        s->note_index++;
+    }
+
+    s->step++;
+    s->grid += length;
+    double swing = (s->step & 1) ? p->swing * length : 0.0;
+
+    wheel_entry next;
+    next.time = std::max(now + 1, (uint64_t)std::llround(s->grid + swing));
+    next.type = SEQ_STEP;
+    s->running = wheel_schedule(&s->wheel, next);
+}
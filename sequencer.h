@@ -0,0 +1,43 @@
+#ifndef RASKOL_SEQUENCER_H
+#define RASKOL_SEQUENCER_H
+
+#include <cstdint>
+
+#include "patch.h"
+#include "timing_wheel.h"
+
+// Arpeggiator driven by the audio thread's sample clock. Held keys come in
+// through the note event queue; each step schedules its notes (and their
+// ratchets) and the following step on the timing wheel, so every note
+// starts on its exact sample whatever the buffer size.
+
+const int ARP_MAX_HELD = 32;
+
+typedef struct {
+    timing_wheel wheel;
+
+    int   held_count;           // in press order
+    int   held_key[ARP_MAX_HELD];
+    float held_frequency[ARP_MAX_HELD];
+    float held_increment[ARP_MAX_HELD];
+
+    bool     running;           // a step is scheduled
+    double   grid;              // unswung start of the current step
+    unsigned long step;         // position in the pattern
+    unsigned long note_index;   // position in the arpeggio
+    uint32_t random;
+}
+sequencer;
+
+void sequencer_init(sequencer *s);
+
+// Audio thread: key presses and releases while the arpeggiator is on. The
+// first held key starts the pattern at `now`.
+void sequencer_hold(sequencer *s, int key, float frequency, float phase_increment, uint64_t now);
+void sequencer_release(sequencer *s, int key);
+
+// Audio thread: runs the step due at `now`, scheduling its notes and the
+// next step. Stops when no key is held or the arpeggiator is switched off.
+void sequencer_step(sequencer *s, const patch *p, int sample_rate, uint64_t now);
+
+#endif
@@ -0,0 +1,160 @@
+#include "shm_ring.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t ring_size(uint32_t capacity, uint32_t channels) {
+    return SHM_RING_HEADER + (size_t)capacity * channels * sizeof(float);
+}
+
+static bool map(shm_ring *r, int prot) {
+    void *base = mmap(NULL, r->size, prot, MAP_SHARED, r->fd, 0);
+    if (base == MAP_FAILED)
+        return false;
+    r->header  = (shm_ring_header*)base;
+    r->samples = (float*)((char*)base + SHM_RING_HEADER);
+    return true;
+}
+
+bool shm_ring_create(shm_ring *r, int sample_rate, int channels) {
+    r->fd = memfd_create("raskol-output", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (r->fd == -1) {
+        std::cerr << "Error creating shared output ring: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Sealed at its final size, so a reader's mapping can never be cut short.
+    r->size = ring_size(SHM_RING_FRAMES, channels);
+    if (ftruncate(r->fd, (off_t)r->size) == -1
+        || fcntl(r->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1
+        || !map(r, PROT_READ | PROT_WRITE)) {
+        std::cerr << "Error sizing shared output ring: " << strerror(errno) << std::endl;
+        close(r->fd);
+        r->fd = -1;
+        return false;
+    }
+
+    // Touch every page now rather than in the audio callback.
+    memset((void*)r->header, 0, r->size);
+    shm_ring_header *h = r->header;
+    memcpy(h->magic, SHM_RING_MAGIC, sizeof(h->magic));
+    h->version     = SHM_RING_VERSION;
+    h->header_size = SHM_RING_HEADER;
+    h->sample_rate = sample_rate;
+    h->channels    = channels;
+    h->capacity    = SHM_RING_FRAMES;
+    h->format      = SHM_RING_FLOAT32;
+    h->frames.store(0);
+    h->writing.store(0);
+    h->blocks.store(0);
+    h->running.store(1, std::memory_order_release);
+
+    std::cerr << "Shared output ring: /proc/" << getpid() << "/fd/" << r->fd << std::endl;
+    return true;
+}
+
+void shm_ring_write(shm_ring *r, const float *samples, unsigned long frames) {
+    shm_ring_header *h = r->header;
+    uint32_t channels  = h->channels;
+    uint64_t start     = h->frames.load(std::memory_order_relaxed);
+
+    // Only the newest ring's worth of a huge block could be read anyway.
+    if (frames > h->capacity) {
+        samples += (frames - h->capacity) * channels;
+        start   += frames - h->capacity;
+        frames   = h->capacity;
+    }
+
+    // Readers must see the overwrite coming before any of it lands.
+    h->writing.store(start + frames, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t offset = start & (h->capacity - 1);
+    size_t first  = std::min<size_t>(frames, h->capacity - offset);
+    memcpy(r->samples + offset * channels, samples, first * channels * sizeof(float));
+    memcpy(r->samples, samples + first * channels, (frames - first) * channels * sizeof(float));
+
+    h->frames.store(start + frames, std::memory_order_release);
+    h->blocks.store(h->blocks.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool shm_ring_attach(shm_ring *r, const char *path) {
+    r->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (r->fd == -1) {
+        std::cerr << "Error opening " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    r->size = fstat(r->fd, &st) == 0 ? (size_t)st.st_size : 0;
+    if (r->size < SHM_RING_HEADER || !map(r, PROT_READ)) {
+        std::cerr << "Not a shared output ring: " << path << std::endl;
+        close(r->fd);
+        return false;
+    }
+
+    const shm_ring_header *h = r->header;
+    bool valid = memcmp(h->magic, SHM_RING_MAGIC, sizeof(h->magic)) == 0
+                 && h->version == SHM_RING_VERSION
+                 && h->header_size == SHM_RING_HEADER
+                 && h->format == SHM_RING_FLOAT32
+                 && h->channels > 0 && h->capacity > 0
+                 && (h->capacity & (h->capacity - 1)) == 0
+                 && r->size == ring_size(h->capacity, h->channels);
+    if (!valid) {
+        std::cerr << "Not a shared output ring: " << path << std::endl;
+        shm_ring_close(r, false);
+        return false;
+    }
+    return true;
+}
+
+size_t shm_ring_read(const shm_ring *r, uint64_t *position, float *out, size_t max, uint64_t *lost) {
+    const shm_ring_header *h = r->header;
+    uint32_t channels = h->channels;
+    uint64_t capacity = h->capacity;
+
+    uint64_t end = h->frames.load(std::memory_order_acquire);
+    if (end - *position > capacity) {
+        *lost    += end - capacity - *position;
+        *position = end - capacity;
+    }
+
+    size_t n      = (size_t)std::min<uint64_t>(end - *position, max);
+    size_t offset = *position & (capacity - 1);
+    size_t first  = std::min<size_t>(n, capacity - offset);
+    memcpy(out, r->samples + offset * channels, first * channels * sizeof(float));
+    memcpy(out + first * channels, r->samples, (n - first) * channels * sizeof(float));
+
+    // Whatever the writer lapped during the copy, or is overwriting now,
+    // is torn.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t now  = h->writing.load(std::memory_order_relaxed);
+    uint64_t safe = now > capacity ? now - capacity : 0;
+    if (*position < safe) {
+        size_t torn = (size_t)std::min<uint64_t>(safe - *position, n);
+        memmove(out, out + torn * channels, (n - torn) * channels * sizeof(float));
+        n         -= torn;
+        *lost     += torn;
+        *position += torn;
+    }
+
+    *position += n;
+    return n;
+}
+
+void shm_ring_close(shm_ring *r, bool writer) {
+    if (r->fd == -1)
+        return;
+    if (writer)
+        r->header->running.store(0, std::memory_order_release);
+    munmap(r->header, r->size);
+    close(r->fd);
+    r->fd = -1;
+}
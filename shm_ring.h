@@ -0,0 +1,79 @@
+#ifndef RASKOL_SHM_RING_H
+#define RASKOL_SHM_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Output stream published in a memfd-backed shared memory ring, so local
+// analysers and recorders can map it and read the audio without a sound
+// server or a copy per consumer. There is one writer, the audio callback,
+// and any number of readers; readers never hold the writer up, a reader
+// that falls more than a ring behind loses the oldest samples.
+//
+// Layout: a SHM_RING_HEADER byte header, then `capacity` frames of
+// native-endian 32-bit float samples, `channels` interleaved. Frame n
+// lives at index n & (capacity - 1).
+//
+// Writing: `writing` is raised to the end of a block before any of its
+// samples are stored (release fence), `frames` once they all are.
+//
+// Reading: load `frames` (acquire); copy the frames between your position
+// and it, at most `capacity` back; then an acquire fence and a load of
+// `writing`: any frame more than `capacity` behind that may have been
+// overwritten while it was copied and must be discarded. shm_ring_read does
+// exactly this.
+//
+// The file can be opened through /proc/<pid>/fd/<fd> (printed on startup)
+// or received over the control socket with the `share` command.
+
+const char     SHM_RING_MAGIC[8] = "RASKOLR";
+const uint32_t SHM_RING_VERSION  = 2;
+const size_t   SHM_RING_HEADER   = 4096;
+const uint32_t SHM_RING_FRAMES   = 1 << 16;  // power of two
+const uint32_t SHM_RING_FLOAT32  = 1;
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;       // bytes before the first sample
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t capacity;          // frames
+    uint32_t format;            // SHM_RING_FLOAT32
+    alignas(64) std::atomic<uint64_t> frames;   // frames written since start
+    std::atomic<uint64_t> writing;              // end of the block being written
+    std::atomic<uint64_t> blocks;               // callbacks written since start
+    std::atomic<uint32_t> running;              // 0 once the writer has stopped
+}
+shm_ring_header;
+
+static_assert(sizeof(shm_ring_header) <= SHM_RING_HEADER, "ring header too large");
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "ring counters must be plain words");
+
+typedef struct {
+    int fd;
+    size_t size;
+    shm_ring_header *header;
+    float *samples;
+}
+shm_ring;
+
+// Writer: creates, sizes and seals the memfd and maps it.
+bool shm_ring_create(shm_ring *r, int sample_rate, int channels);
+
+// Audio thread: never blocks or allocates.
+void shm_ring_write(shm_ring *r, const float *samples, unsigned long frames);
+
+// Reader: maps an existing ring read-only.
+bool shm_ring_attach(shm_ring *r, const char *path);
+
+// Reader: copies up to `max` frames from *position on, advancing it.
+// Frames that were overwritten before they could be read are skipped and
+// added to *lost.
+size_t shm_ring_read(const shm_ring *r, uint64_t *position, float *out, size_t max, uint64_t *lost);
+
+// Marks the ring stopped (writer only) and unmaps it.
+void shm_ring_close(shm_ring *r, bool writer);
+
+#endif
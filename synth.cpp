@@ -0,0 +1,599 @@
+#include "synth.h"
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "audio_guard.h"
+#include "fast_math.h"
+#include "trace.h"
+
+static void render_scalar(pa_data *data, const patch *p, float *out, unsigned long frames);
+
+static void render_block(pa_data *data, const patch *p, float *out, unsigned long frames);
+
+static void render_multirate(pa_data *data, const patch *p, float *out, unsigned long frames);
+
+static void render_voices(pa_data *data, const patch *p, float *out, unsigned long frames, bool multirate);
+
+static void set_waveform(patch_bank *bank, int waveform);
+
+static int get_note(pa_data *data);
+
+static int start_voice(pa_data *data, const patch *p, float frequency, float phase_increment);
+
+static void mod_tick(pa_data *data, const patch *p, uint64_t now);
+
+static void handle_event(pa_data *data, const patch *p, const note_event &e);
+
+static void fire_due(pa_data *data, const patch *p);
+
+static void render(pa_data *data, const patch *p, graph *g, float *out, unsigned long frames);
+
+static void engine_block(pa_data *data, const patch *p, graph *g, float *out, unsigned long frames);
+
+static void pull(pa_data *data, const patch *p, graph *g, float *out, unsigned long frames, bool exact);
+
+static void process(pa_data *data, float *out, unsigned long frames, bool exact);
+
+static void apply_events(pa_data *data, const patch *p);
+
+static void render_grains(pa_data *data, const patch *p, float *out, unsigned long frames);
+
+static void run_voices(void *user, float *out, unsigned long frames);
+
+static void run_grains(void *user, float *inout, unsigned long frames);
+
+const render_kernel RENDER_KERNELS[] = {
+    {"multirate", render_multirate, 5e-5f, true},
+    {"block",     render_block,     1e-5f, true},
+    {"scalar",    render_scalar,    0.0f,  false}
+};
+
+const int RENDER_KERNEL_COUNT = sizeof(RENDER_KERNELS) / sizeof(RENDER_KERNELS[0]);
+
+// The fixed signal path before graphs: the voices, then the grain cloud.
+const char DEFAULT_GRAPH[] =
+    "voices voices\n"
+    "out    grains voices\n";
+
+// What the engine's graph nodes work on during one render call.
+typedef struct {
+    pa_data     *data;
+    const patch *p;
+}
+engine_context;
+
+float generate_waveform(float phase, int waveform) {
+    float normalizedPhase = phase * FAST_INV_TWO_PI;
+    switch (waveform) {
+        case 0: // sine
+            return fast_sin(phase);
+        case 1: // sawthooth
+            return (normalizedPhase * 2.0f) - 1.0f;
+        case 2: { // square
+            float value = 0.0f;
+            for (int k = 1; k <= 7; k += 2) {
+                value += fast_sin_turns(k * normalizedPhase) / k;
+            }
+            return (4.0f / (float)M_PI) * value;
+        }
+        case 3:
+            return 2.0f * std::fabs(2.0f * normalizedPhase - 1.0f) - 1.0f;
+        default:
+            return fast_sin(phase);
+    }
+}
+
+void synth_init(pa_data *data, const scale &s, const keyboard_map &m, const patch &initial) {
+    data->dx = 1.0f / SAMPLE_RATE;
+
+    tuning_compile(&data->keys, s, m, SAMPLE_RATE);
+    std::fill(data->key_to_note, data->key_to_note + TUNING_KEYS + TUNING_NOTES, -1);
+    data->notes.resize(MAX_NOTES);
+    data->note_count = 0;
+    event_queue_init(&data->events);
+
+    patch_bank_init(&data->patches, initial);
+    data->amplitude = initial.amplitude;
+    data->headroom  = 1.0f;
+
+    data->resampling = false;
+    rt_defaults(&data->rt);
+    data->kernel = &RENDER_KERNELS[0];
+    data->dsp    = dsp_active();
+    data->scratch.assign(5 * ENGINE_BLOCK, 0.0f);
+    data->block_left = 0;
+    limiter_init(&data->master, SAMPLE_RATE);
+    sequencer_init(&data->seq);
+    mod_init(&data->mods);
+    grains_init(&data->cloud);
+    strings_init(&data->strings, MAX_NOTES);
+    voice_rates_init(&data->rates, data->dx);
+
+    graph *g = NULL;
+    graph_compile(DEFAULT_GRAPH, "default graph", SAMPLE_RATE, ENGINE_BLOCK, &g);
+    graph_bank_init(&data->graphs, g);
+    graph_workers_init(&data->workers);
+    data->clock = 0;
+    data->quiet = 0;
+    data->quiet_graph = NULL;
+    data->idle.store(0);
+}
+
+const render_kernel *synth_find_kernel(const char *name) {
+    for (int i = 0; i < RENDER_KERNEL_COUNT; i++) {
+        if (strcmp(RENDER_KERNELS[i].name, name) == 0)
+            return &RENDER_KERNELS[i];
+    }
+    return NULL;
+}
+
+void synth_free(pa_data *data) {
+    graph_workers_stop(&data->workers);
+    graph_bank_free(&data->graphs);
+    patch_bank_free(&data->patches);
+}
+
+void synth_process(pa_data *data, float *out, unsigned long frames_per_buffer) {
+    process(data, out, frames_per_buffer, false);
+}
+
+void synth_render(pa_data *data, float *out, unsigned long frames) {
+    process(data, out, frames, true);
+}
+
+bool synth_input(pa_data *data, const input_event &event) {
+    if (event.type != EV_KEY)
+        return true;
+
+    if (event.code < TUNING_KEYS && data->keys.frequency[event.code] > 0.0f) {
+        if (event.value == 1 || event.value == 0) {
+            note_event e;
+            e.type            = event.value == 1 ? NOTE_ON : NOTE_OFF;
+            e.key             = event.code;
+            e.frequency       = data->keys.frequency[event.code];
+            e.phase_increment = data->keys.phase_increment[event.code];
+            if (!event_queue_push(&data->events, e))
+                std::cerr << "Event queue full, dropped key " << event.code << std::endl;
+        }
+    } else if (event.code == KEY_Z && event.value == 1) {
+        return false;
+    }
+    else if (event.code == KEY_X) set_waveform(&data->patches, 0);
+    else if (event.code == KEY_C) set_waveform(&data->patches, 1);
+    else if (event.code == KEY_V) set_waveform(&data->patches, 2);
+    else if (event.code == KEY_B) set_waveform(&data->patches, 3);
+    else if (event.code == KEY_N) set_waveform(&data->patches, WAVEFORM_STRING);
+
+    return true;
+}
+
+bool synth_note(pa_data *data, int note, bool on) {
+    if (note < 0 || note >= TUNING_NOTES || data->keys.note_frequency[note] <= 0.0f)
+        return false;
+
+    note_event e;
+    e.type            = on ? NOTE_ON : NOTE_OFF;
+    e.key             = TUNING_KEYS + note;
+    e.frequency       = data->keys.note_frequency[note];
+    e.phase_increment = data->keys.note_increment[note];
+    return event_queue_push(&data->events, e);
+}
+
+static void render_scalar(pa_data *data, const patch *p, float *out, unsigned long frames) {
+    bool modulated = mod_active(p);
+    bool strings   = p->waveform == WAVEFORM_STRING;
+
+    for (unsigned long i = 0; i < frames; i++) {
+        float sound = 0.0f;
+        int active_notes = 0;
+
+        if (modulated && (data->clock + i) % p->control_period == 0)
+            mod_tick(data, p, data->clock + i);
+
+        data->amplitude += (p->amplitude - data->amplitude) * AMPLITUDE_SMOOTHING;
+
+        for (size_t j = 0; j < data->note_count; j++) {
+            if (data->notes[j].is_playing) {
+                float waveform, volume;
+                if (strings) {
+                    // The string decays by itself; no envelope.
+                    waveform = string_tick(&data->strings, (int)j);
+                    volume   = 1.0f;
+                } else {
+                    data->notes[j].volume += data->notes[j].d_volume * data->dx;
+
+                    if (data->notes[j].volume < 1.0f) {
+                        data->notes[j].d_volume += (1.0f - data->notes[j].volume) * data->dx;
+                    } else {
+                        data->notes[j].d_volume -= 0.01f * data->dx;
+                    }
+
+                    data->notes[j].volume = std::max(0.0f, std::min(data->notes[j].volume, 1.0f));
+
+                    waveform = generate_waveform(data->notes[j].phase, p->waveform);
+                    volume   = data->notes[j].volume;
+                }
+
+                if (modulated) {
+                    sound += waveform * (volume * data->notes[j].mod_gain);
+                    data->notes[j].mod_gain += data->notes[j].mod_step;
+                } else {
+                    sound += (waveform * volume);
+                }
+                active_notes++;
+
+                data->notes[j].time += data->dx;
+            }
+
+            data->notes[j].phase += modulated ? data->notes[j].mod_increment : data->notes[j].phase_increment;
+            if (data->notes[j].phase >= 2.0f * M_PI)
+                data->notes[j].phase -= 2.0f * M_PI;
+        }
+
+        float target = 1.0f / std::sqrt((float)std::max(active_notes, 1));
+        data->headroom += (target - data->headroom) * HEADROOM_SMOOTHING;
+
+        *out++ = sound * (data->amplitude * data->headroom);
+    }
+}
+
+// Same voice model as render_scalar, restructured per voice over a block so
+// the oscillator, mixing and gain loops run on the selected ISA. Voices only
+// start and stop between blocks, so the active count is fixed per call.
+// With modulation on, blocks also end at every control point.
+static void render_block(pa_data *data, const patch *p, float *out, unsigned long frames) {
+    render_voices(data, p, out, frames, false);
+}
+
+// render_block with band-limited voices at a decimated rate and envelopes
+// from points every few samples; see voice_rate.h.
+static void render_multirate(pa_data *data, const patch *p, float *out, unsigned long frames) {
+    render_voices(data, p, out, frames, true);
+}
+
+static void render_voices(pa_data *data, const patch *p, float *out, unsigned long frames, bool multirate) {
+    float *gain   = data->scratch.data();
+    float *sum    = gain + ENGINE_BLOCK;
+    float *wave   = sum + ENGINE_BLOCK;
+    float *volume = wave + ENGINE_BLOCK;
+    float *low    = volume + ENGINE_BLOCK;
+    const dsp_kernels *k = data->dsp;
+
+    int active_notes = 0;
+    for (size_t j = 0; j < data->note_count; j++)
+        active_notes += data->notes[j].is_playing;
+    float target = 1.0f / std::sqrt((float)std::max(active_notes, 1));
+
+    bool modulated = mod_active(p);
+    bool strings   = p->waveform == WAVEFORM_STRING;
+    uint64_t now   = data->clock;
+
+    while (frames > 0) {
+        unsigned long n = std::min(frames, ENGINE_BLOCK);
+        if (modulated) {
+            unsigned long offset = (unsigned long)(now % p->control_period);
+            if (offset == 0)
+                mod_tick(data, p, now);
+            n = std::min(n, p->control_period - offset);
+        }
+
+        for (unsigned long i = 0; i < n; i++) {
+            data->amplitude += (p->amplitude - data->amplitude) * AMPLITUDE_SMOOTHING;
+            data->headroom  += (target - data->headroom) * HEADROOM_SMOOTHING;
+            gain[i] = data->amplitude * data->headroom;
+        }
+        std::fill(sum, sum + n, 0.0f);
+
+        uint64_t voices_began = trace_enabled ? trace_ticks() : 0;
+        for (size_t j = 0; j < data->note_count; j++) {
+            note &v = data->notes[j];
+            float increment = modulated ? v.mod_increment : v.phase_increment;
+            if (!v.is_playing && multirate) {
+                voice_skip(&v.phase, increment, n);
+                continue;
+            }
+            if (!v.is_playing) {
+                for (unsigned long i = 0; i < n; i++) {
+                    v.phase += increment;
+                    if (v.phase >= 2.0f * M_PI)
+                        v.phase -= 2.0f * M_PI;
+                }
+                continue;
+            }
+
+            if (strings)
+                std::fill(volume, volume + n, 1.0f);
+            else if (!multirate || !voice_envelope(&data->rates, &v.volume, &v.d_volume, data->dx, volume, n))
+                k->envelope(&v.volume, &v.d_volume, data->dx, volume, n);
+            if (modulated) {
+                for (unsigned long i = 0; i < n; i++) {
+                    volume[i] *= v.mod_gain;
+                    v.mod_gain += v.mod_step;
+                }
+            }
+            int shift = multirate && !strings ? voice_rate(p->waveform, increment) : 0;
+            if (strings)
+                string_render(&data->strings, (int)j, wave, n);
+            else if (shift > 0)
+                voice_oscillator(&data->rates, k, p->waveform, &v.phase, increment, shift, low, wave, n);
+            else
+                k->oscillator(p->waveform, &v.phase, increment, wave, n);
+            k->mix(sum, wave, volume, n);
+            v.time += data->dx * n;
+        }
+
+        if (trace_enabled)
+            trace_record("voices", voices_began, trace_ticks(), active_notes);
+
+        trace_scope mix("mix", n);
+        k->apply_gain(out, sum, gain, 1.0f, n);
+
+        out += n;
+        now += n;
+        frames -= n;
+    }
+}
+
+static void set_waveform(patch_bank *bank, int waveform) {
+    patch next = *patch_acquire(bank);
+    if (next.waveform == waveform)
+        return;
+    next.waveform = waveform;
+    patch_publish(bank, next);
+}
+
+static int get_note(pa_data *data) {
+    for (size_t i = 0; i < data->note_count; i++) {
+        if (!data->notes[i].is_playing) {
+            return i;
+        }
+    }
+
+    if (data->note_count == data->notes.size())
+        return -1;
+    data->notes[data->note_count] = {0.0f, 0.0f, false, 0.0f, 0.0f, 0.0f, 0.0f, 3.0f, 0.0f, 1.0f, 0.0f, 0};
+    return data->note_count++;
+}
+
+static int start_voice(pa_data *data, const patch *p, float frequency, float phase_increment) {
+    int note_idx = get_note(data);
+    if (note_idx == -1)
+        return -1;
+    note &v = data->notes[note_idx];
+    v.time = 0.0f;
+    v.frequency = frequency;
+    v.phase_increment = phase_increment;
+    v.is_playing = true;
+
+    // Starts at the current control point's values rather than ramping in.
+    float pitch, gain;
+    mod_targets(&data->mods, p, 0, SAMPLE_RATE, &pitch, &gain);
+    v.mod_increment = phase_increment * pitch;
+    v.mod_gain      = gain;
+    v.mod_step      = 0.0f;
+    v.started       = data->clock;
+    if (p->waveform == WAVEFORM_STRING)
+        string_excite(&data->strings, note_idx, p, frequency * pitch, SAMPLE_RATE);
+    return note_idx;
+}
+
+// A control point: new LFO values, then every playing voice's pitch and a
+// gain ramp that lands on its target at the next control point.
+static void mod_tick(pa_data *data, const patch *p, uint64_t now) {
+    mod_advance(&data->mods, p, SAMPLE_RATE);
+    for (size_t j = 0; j < data->note_count; j++) {
+        note &v = data->notes[j];
+        if (!v.is_playing)
+            continue;
+        float pitch, gain;
+        mod_targets(&data->mods, p, now - v.started, SAMPLE_RATE, &pitch, &gain);
+        float increment = v.phase_increment * pitch;
+        if (p->waveform == WAVEFORM_STRING && increment != v.mod_increment)
+            string_tune(&data->strings, (int)j, p, v.frequency * pitch, SAMPLE_RATE);
+        v.mod_increment = increment;
+        v.mod_step      = (gain - v.mod_gain) / p->control_period;
+    }
+}
+
+static void handle_event(pa_data *data, const patch *p, const note_event &e) {
+    if (e.type == NOTE_ON) {
+        if (p->arp != ARP_OFF) {
+            sequencer_hold(&data->seq, e.key, e.frequency, e.phase_increment, data->clock);
+            return;
+        }
+        // A repeated note-on retriggers: the old voice is released first,
+        // or nothing could ever release it once the key maps elsewhere.
+        if (data->key_to_note[e.key] != -1) {
+            data->notes[data->key_to_note[e.key]].is_playing = false;
+            data->key_to_note[e.key] = -1;
+        }
+        int note_idx = start_voice(data, p, e.frequency, e.phase_increment);
+        if (note_idx != -1)
+            data->key_to_note[e.key] = note_idx;
+    } else if (e.type == NOTE_OFF) {
+        sequencer_release(&data->seq, e.key);
+        int note_idx = data->key_to_note[e.key];
+        if (note_idx != -1) {
+            data->notes[note_idx].is_playing = false;
+            data->key_to_note[e.key] = -1;
+        }
+    }
+}
+
+static void fire_due(pa_data *data, const patch *p) {
+    wheel_entry e;
+    while (wheel_pop(&data->seq.wheel, data->clock, &e)) {
+        if (e.type == SEQ_STEP) {
+            sequencer_step(&data->seq, p, SAMPLE_RATE, data->clock);
+        } else if (e.type == SEQ_NOTE_ON) {
+            int note_idx = start_voice(data, p, e.frequency, e.phase_increment);
+            if (note_idx == -1)
+                continue;
+            wheel_entry off;
+            off.time  = data->clock + e.duration;
+            off.type  = SEQ_NOTE_OFF;
+            off.voice = note_idx;
+            if (!wheel_schedule(&data->seq.wheel, off))
+                data->notes[note_idx].is_playing = false;
+        } else if (e.type == SEQ_NOTE_OFF) {
+            data->notes[e.voice].is_playing = false;
+        }
+    }
+}
+
+// Runs the graph at SAMPLE_RATE, stopping at each sample the sequencer has
+// something due so its notes land exactly.
+static void render(pa_data *data, const patch *p, graph *g, float *out, unsigned long frames) {
+    engine_context context = {data, p};
+    graph_engine engine = {&context, run_voices, run_grains};
+
+    while (frames > 0) {
+        fire_due(data, p);
+        uint64_t until = wheel_next(&data->seq.wheel, data->clock + 1, data->clock + frames);
+        unsigned long n = (unsigned long)(until - data->clock);
+
+        {
+            trace_scope span("graph", n);
+            graph_run(g, &data->workers, &engine, data->dsp, out, n);
+        }
+        data->clock += n;
+        out    += n;
+        frames -= n;
+    }
+}
+
+static void apply_events(pa_data *data, const patch *p) {
+    trace_scope span("events");
+    note_event e;
+    while (event_queue_pop(&data->events, &e)) {
+        handle_event(data, p, e);
+        span.arg++;
+    }
+}
+
+// Nothing playing, no grain left and nothing on the sequencer's wheel.
+static bool sources_silent(const pa_data *data) {
+    for (size_t j = 0; j < data->note_count; j++) {
+        if (data->notes[j].is_playing)
+            return false;
+    }
+    return data->cloud.active == 0 && data->seq.wheel.count == 0;
+}
+
+// One engine block at SAMPLE_RATE, through the master limiter. Idle blocks
+// only move the clock; the live grain history is cleared as it would have
+// been, and left alone once it is all silence. A new graph may sound on its
+// own, so silence is measured again from its first block.
+static void engine_block(pa_data *data, const patch *p, graph *g, float *out, unsigned long frames) {
+    if (g != data->quiet_graph) {
+        data->quiet = 0;
+        data->quiet_graph = g;
+    }
+    bool silent = sources_silent(data);
+    if (silent && data->quiet >= g->tail + (uint64_t)limiter_latency(&data->master)) {
+        trace_scope span("idle", frames);
+        std::fill(out, out + frames, 0.0f);
+        uint64_t idle = data->idle.load(std::memory_order_relaxed);
+        if (idle < GRAIN_SOURCE)
+            grains_silence(&data->cloud, frames);
+        data->idle.store(idle + frames, std::memory_order_relaxed);
+        data->clock += frames;
+        return;
+    }
+    data->idle.store(0, std::memory_order_relaxed);
+
+    render(data, p, g, out, frames);
+    trace_scope span("limiter", frames);
+    limiter_process(&data->master, data->dsp, out, frames);
+
+    for (unsigned long i = 0; silent && i < frames; i++)
+        silent = std::fabs(out[i]) < IDLE_LEVEL;
+    data->quiet = silent ? data->quiet + frames : 0;
+}
+
+// Fills `out` with the rest of the previous block, then whole blocks. A
+// remainder comes from one more block, whose tail waits in data->block;
+// `exact` renders a short block instead.
+static void pull(pa_data *data, const patch *p, graph *g, float *out, unsigned long frames, bool exact) {
+    unsigned long left = std::min(frames, data->block_left);
+    const float *rest  = data->block + ENGINE_BLOCK - data->block_left;
+    std::copy(rest, rest + left, out);
+    data->block_left -= left;
+    out    += left;
+    frames -= left;
+
+    while (frames >= ENGINE_BLOCK) {
+        engine_block(data, p, g, out, ENGINE_BLOCK);
+        out    += ENGINE_BLOCK;
+        frames -= ENGINE_BLOCK;
+    }
+    if (frames == 0)
+        return;
+
+    if (exact) {
+        engine_block(data, p, g, out, frames);
+        return;
+    }
+    engine_block(data, p, g, data->block, ENGINE_BLOCK);
+    std::copy(data->block, data->block + frames, out);
+    data->block_left = ENGINE_BLOCK - frames;
+}
+
+// The audio thread's whole render, guarded for both the live and the
+// offline path. `exact` is the offline one, always at SAMPLE_RATE.
+static void process(pa_data *data, float *out, unsigned long frames, bool exact) {
+    audio_guard_scope guard;
+
+    const patch *p = patch_acquire(&data->patches);
+    graph *g = graph_acquire(&data->graphs);
+    apply_events(data, p);
+
+    if (exact || !data->resampling) {
+        pull(data, p, g, out, frames, exact);
+        graph_release(&data->graphs);
+        patch_release(&data->patches);
+        return;
+    }
+
+    while (frames > 0) {
+        unsigned long chunk  = std::min(frames, data->rate_converter.max_out);
+        unsigned long needed = resampler_input_needed(&data->rate_converter, chunk);
+
+        pull(data, p, g, data->render_buffer.data(), needed, false);
+        {
+            trace_scope span("resample", chunk);
+            resampler_process(&data->rate_converter, data->render_buffer.data(), needed, out, chunk);
+        }
+
+        out    += chunk;
+        frames -= chunk;
+    }
+    graph_release(&data->graphs);
+    patch_release(&data->patches);
+}
+
+// Grains take their pitch from whichever voices are playing.
+static void render_grains(pa_data *data, const patch *p, float *out, unsigned long frames) {
+    trace_scope span("grains", data->cloud.active);
+    float pitches[MAX_NOTES];
+    int count = 0;
+    for (size_t j = 0; j < data->note_count; j++) {
+        if (data->notes[j].is_playing)
+            pitches[count++] = data->notes[j].frequency;
+    }
+    grains_process(&data->cloud, data->dsp, p, pitches, count, SAMPLE_RATE, data->amplitude, out, frames);
+}
+
+static void run_voices(void *user, float *out, unsigned long frames) {
+    engine_context *c = (engine_context*)user;
+    c->data->kernel->render(c->data, c->p, out, frames);
+}
+
+static void run_grains(void *user, float *inout, unsigned long frames) {
+    engine_context *c = (engine_context*)user;
+    if (c->p->grains > 0.0f)
+        render_grains(c->data, c->p, inout, frames);
+}
@@ -0,0 +1,140 @@
+#ifndef RASKOL_SYNTH_H
+#define RASKOL_SYNTH_H
+
+#include <atomic>
+#include <linux/input.h>
+#include <vector>
+
+#include "event_queue.h"
+#include "grains.h"
+#include "graph.h"
+#include "kernels.h"
+#include "limiter.h"
+#include "mod.h"
+#include "patch.h"
+#include "resampler.h"
+#include "sequencer.h"
+#include "rt.h"
+#include "tuning.h"
+#include "voice_rate.h"
+#include "waveguide.h"
+
+const int SAMPLE_RATE = 44100;
+const int MAX_NOTES   = 64;
+
+// The engine renders in blocks of this many samples at SAMPLE_RATE,
+// whatever the host buffer size; a one-block FIFO adapts between them.
+// Sequencer events and control points can still split a block.
+const unsigned long ENGINE_BLOCK = 64;
+
+// Per-sample smoothing of amplitude changes between patches (~5 ms).
+const float AMPLITUDE_SMOOTHING = 0.0045f;
+
+// Per-sample smoothing of the polyphony headroom gain (~20 ms). The mix is
+// scaled towards 1/sqrt(voices) and the master limiter catches the peaks
+// while it settles.
+const float HEADROOM_SMOOTHING = 0.0011f;
+
+// Output under this level (-100 dBFS) counts as silence while no voice
+// plays. Once it has lasted the graph's tail plus the limiter's lookahead,
+// the engine is idle: blocks are zeroed instead of rendered until a voice
+// starts or the sequencer has something due.
+const float IDLE_LEVEL = 1e-5f;
+
+typedef struct {
+    float phase;
+    float amplitude;
+    bool  is_playing;
+    float frequency;
+    float phase_increment;
+    float time;
+    float volume;
+    float d_volume;
+    float mod_increment;        // phase_increment with pitch modulation
+    float mod_gain;             // ramps to the next control point's gain
+    float mod_step;
+    uint64_t started;           // clock at note on
+}
+note;
+
+typedef struct pa_data pa_data;
+
+typedef void (*render_fn)(pa_data *data, const patch *p, float *out, unsigned long frames);
+
+// A render kernel and its accuracy contract against the scalar reference:
+// max_error 0 means the output must match it bit for bit. Dispatched
+// kernels run on pa_data::dsp and must meet the contract on every ISA.
+typedef struct {
+    const char *name;
+    render_fn   render;
+    float       max_error;
+    bool        dispatched;
+}
+render_kernel;
+
+extern const render_kernel RENDER_KERNELS[];
+extern const int RENDER_KERNEL_COUNT;
+
+struct pa_data {
+    std::vector<note> notes;
+    size_t note_count;              // voices used so far; never shrinks
+    event_queue events;
+    patch_bank patches;
+    float amplitude;
+    float headroom;
+    tuning keys;
+    int key_to_note[TUNING_KEYS + TUNING_NOTES];    // evdev keys, then MIDI notes
+    float dx;
+    bool resampling;
+    resampler rate_converter;
+    std::vector<float> render_buffer;
+    rt_mode rt;
+    const render_kernel *kernel;
+    const dsp_kernels *dsp;
+    std::vector<float> scratch;     // 5 * ENGINE_BLOCK
+    float block[ENGINE_BLOCK];      // last block, partly handed out
+    unsigned long block_left;       // samples of it still to hand out
+    limiter master;
+    sequencer seq;
+    mod_lfos mods;
+    granular cloud;
+    string_bank strings;            // one line per note slot
+    voice_rates rates;
+    graph_bank graphs;
+    graph_workers workers;          // none unless started
+    uint64_t clock;                 // samples rendered at SAMPLE_RATE
+    uint64_t quiet;                 // samples of silence rendered in a row
+    const graph *quiet_graph;       // the graph they were rendered with
+    std::atomic<uint64_t> idle;     // samples zeroed since the engine went idle
+};
+
+float generate_waveform(float phase, int waveform);
+
+void synth_init(pa_data *data, const scale &s, const keyboard_map &m, const patch &initial);
+
+const render_kernel *synth_find_kernel(const char *name);
+
+// Stream must be stopped.
+void synth_free(pa_data *data);
+
+// Audio thread: applies queued events, then renders `frames` samples at the
+// output rate. Whole engine blocks are rendered and any part of the last
+// one not needed yet is kept for the next call, so events take effect at
+// the next block not yet rendered.
+void synth_process(pa_data *data, float *out, unsigned long frames);
+
+// Offline: like synth_process at SAMPLE_RATE, but the last block is cut
+// short instead of rendered ahead, so events applied between calls land
+// on their exact sample.
+void synth_render(pa_data *data, float *out, unsigned long frames);
+
+// Control thread: turns a keyboard event into note events or patch
+// changes. Returns false for the quit key.
+bool synth_input(pa_data *data, const input_event &event);
+
+// Control thread: a MIDI note from a source other than the keyboard.
+// False if the note is out of range, unmapped by the tuning or the event
+// queue is full; the caller decides how to report it.
+bool synth_note(pa_data *data, int note, bool on);
+
+#endif
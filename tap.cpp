@@ -0,0 +1,132 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shm_ring.h"
+
+// Example reader of the shared output ring: prints the level of the live
+// output ten times a second until the synth stops.
+//
+//   tap /proc/<pid>/fd/<fd>    the path main prints with --share-output
+//   tap <control socket>       asks a synth started with --control for it
+
+const int REPORT_MS = 100;
+
+// Sends `share` and receives the ring's fd with the reply.
+static int request_ring(const char *socket_path) {
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+
+    // Replies need an address to go to; an abstract one leaves no file.
+    sockaddr_un self;
+    memset(&self, 0, sizeof(self));
+    self.sun_family = AF_UNIX;
+    socklen_t self_len = sizeof(sa_family_t) + 1
+                         + snprintf(self.sun_path + 1, sizeof(self.sun_path) - 1, "raskol-tap-%d", (int)getpid());
+
+    sockaddr_un server;
+    memset(&server, 0, sizeof(server));
+    server.sun_family = AF_UNIX;
+    strncpy(server.sun_path, socket_path, sizeof(server.sun_path) - 1);
+
+    const char command[] = "share";
+    timeval timeout = {2, 0};
+    if (bind(fd, (const sockaddr*)&self, self_len) == -1
+        || setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1
+        || sendto(fd, command, sizeof(command) - 1, 0, (const sockaddr*)&server, sizeof(server)) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    char text[64];
+    iovec iov = {text, sizeof(text)};
+    union {
+        cmsghdr header;
+        char    space[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.space;
+    msg.msg_controllen = sizeof(control.space);
+
+    int ring = -1;
+    if (recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) > 0) {
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            memcpy(&ring, CMSG_DATA(cmsg), sizeof(int));
+    }
+    close(fd);
+    return ring;
+}
+
+static double decibels(double level) {
+    return level > 0.0 ? 20.0 * log10(level) : -INFINITY;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " /proc/<pid>/fd/<fd> | control-socket" << std::endl;
+        return 1;
+    }
+
+    std::string path = argv[1];
+    int received = -1;
+    struct stat st;
+    if (stat(argv[1], &st) == 0 && S_ISSOCK(st.st_mode)) {
+        received = request_ring(argv[1]);
+        if (received == -1) {
+            std::cerr << "No shared output ring from " << argv[1] << std::endl;
+            return 1;
+        }
+        path = "/proc/self/fd/" + std::to_string(received);
+    }
+
+    shm_ring ring;
+    bool attached = shm_ring_attach(&ring, path.c_str());
+    if (received != -1)
+        close(received);
+    if (!attached)
+        return 1;
+
+    const shm_ring_header *h = ring.header;
+    std::cerr << h->sample_rate << " Hz, " << h->channels << " channel(s), "
+              << h->capacity << " frame ring" << std::endl;
+
+    std::vector<float> block((size_t)h->capacity * h->channels);
+    uint64_t position = h->frames.load(std::memory_order_acquire);
+    uint64_t lost     = 0;
+    timespec pause    = {0, REPORT_MS * 1000000L};
+
+    while (h->running.load(std::memory_order_acquire)) {
+        nanosleep(&pause, NULL);
+        size_t n = shm_ring_read(&ring, &position, block.data(), h->capacity, &lost);
+
+        double peak = 0.0, energy = 0.0;
+        for (size_t i = 0; i < n * h->channels; i++) {
+            peak    = std::max(peak, (double)fabs(block[i]));
+            energy += (double)block[i] * block[i];
+        }
+        double rms = n > 0 ? sqrt(energy / (n * h->channels)) : 0.0;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "frame " << position << "  peak " << std::setw(6) << decibels(peak)
+                  << " dB  rms " << std::setw(6) << decibels(rms) << " dB  lost " << lost << std::endl;
+    }
+
+    std::cerr << "Writer stopped" << std::endl;
+    shm_ring_close(&ring, false);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "timing_wheel.h"
+
+static const uint64_t SLOT_MASK = WHEEL_SLOTS - 1;
+
+void wheel_init(timing_wheel *w) {
+    for (int i = 0; i < WHEEL_POOL; i++)
+        w->pool[i].next = i + 1 < WHEEL_POOL ? i + 1 : -1;
+    w->free_list = 0;
+    for (int i = 0; i < WHEEL_SLOTS; i++) {
+        w->head[i] = -1;
+        w->tail[i] = -1;
+    }
+    w->count = 0;
+}
+
+bool wheel_schedule(timing_wheel *w, const wheel_entry &e) {
+    int index = w->free_list;
+    if (index == -1)
+        return false;
+    w->free_list = w->pool[index].next;
+
+    w->pool[index]      = e;
+    w->pool[index].next = -1;
+
+    int slot = (int)(e.time & SLOT_MASK);
+    if (w->tail[slot] == -1)
+        w->head[slot] = index;
+    else
+        w->pool[w->tail[slot]].next = index;
+    w->tail[slot] = index;
+    w->count++;
+    return true;
+}
+
+uint64_t wheel_next(const timing_wheel *w, uint64_t from, uint64_t until) {
+    if (w->count == 0)
+        return until;
+    for (uint64_t t = from; t < until; t++) {
+        for (int i = w->head[t & SLOT_MASK]; i != -1; i = w->pool[i].next) {
+            if (w->pool[i].time == t)
+                return t;
+        }
+    }
+    return until;
+}
+
+bool wheel_pop(timing_wheel *w, uint64_t now, wheel_entry *e) {
+    if (w->count == 0)
+        return false;
+
+    int slot = (int)(now & SLOT_MASK);
+    int prev = -1;
+    for (int i = w->head[slot]; i != -1; prev = i, i = w->pool[i].next) {
+        if (w->pool[i].time != now)
+            continue;
+
+        if (prev == -1)
+            w->head[slot] = w->pool[i].next;
+        else
+            w->pool[prev].next = w->pool[i].next;
+        if (w->tail[slot] == i)
+            w->tail[slot] = prev;
+
+        *e = w->pool[i];
+        w->pool[i].next = w->free_list;
+        w->free_list = i;
+        w->count--;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,50 @@
+#ifndef RASKOL_TIMING_WHEEL_H
+#define RASKOL_TIMING_WHEEL_H
+
+#include <cstdint>
+
+// Hashed timing wheel with one slot per sample. Entries come from a fixed
+// pool and are linked into the slot of their due time, so scheduling and
+// firing are O(1) and never allocate. Entries more than a revolution ahead
+// share a slot with nearer ones and are skipped until their time comes.
+
+const int WHEEL_SLOTS = 4096;      // power of two
+const int WHEEL_POOL  = 512;
+
+const int SEQ_STEP     = 0;
+const int SEQ_NOTE_ON  = 1;
+const int SEQ_NOTE_OFF = 2;
+
+typedef struct {
+    uint64_t time;              // sample clock
+    int      type;              // SEQ_*
+    int      voice;             // SEQ_NOTE_OFF
+    float    frequency;         // SEQ_NOTE_ON
+    float    phase_increment;
+    uint32_t duration;          // SEQ_NOTE_ON: samples until its note off
+    int      next;
+}
+wheel_entry;
+
+typedef struct {
+    wheel_entry pool[WHEEL_POOL];
+    int free_list;
+    int head[WHEEL_SLOTS];
+    int tail[WHEEL_SLOTS];
+    int count;
+}
+timing_wheel;
+
+void wheel_init(timing_wheel *w);
+
+// False if the pool is exhausted.
+bool wheel_schedule(timing_wheel *w, const wheel_entry &e);
+
+// Earliest due time in [from, until), or `until` if there is none.
+uint64_t wheel_next(const timing_wheel *w, uint64_t from, uint64_t until);
+
+// Removes the oldest entry due exactly at `now`. Entries scheduled for
+// `now` while draining are returned by the same loop.
+bool wheel_pop(timing_wheel *w, uint64_t now, wheel_entry *e);
+
+#endif
@@ -0,0 +1,140 @@
+#include "trace.h"
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <unistd.h>
+
+typedef struct {
+    std::atomic<uint64_t>    head;      // spans ever written
+    std::atomic<const char*> thread;
+    trace_event *events;                // TRACE_EVENTS
+}
+trace_ring;
+
+bool trace_enabled = false;
+
+static trace_ring rings[TRACE_THREADS];
+static std::atomic<int> ring_count(0);
+static __thread trace_ring *local;
+static __thread bool local_claimed;
+
+// Ticks and wall time when tracing started; the dump measures the tick
+// rate against the same clock.
+static uint64_t start_ticks;
+static std::chrono::steady_clock::time_point start_time;
+
+void trace_init() {
+    for (int i = 0; i < TRACE_THREADS; i++) {
+        rings[i].head.store(0);
+        rings[i].thread.store(NULL);
+        rings[i].events = new trace_event[TRACE_EVENTS]();
+    }
+    start_time    = std::chrono::steady_clock::now();
+    start_ticks   = trace_ticks();
+    trace_enabled = true;
+}
+
+static trace_ring *claim() {
+    if (!local_claimed) {
+        local_claimed = true;
+        int i = ring_count.load();
+        while (i < TRACE_THREADS && !ring_count.compare_exchange_weak(i, i + 1)) {}
+        local = i < TRACE_THREADS ? &rings[i] : NULL;
+    }
+    return local;
+}
+
+void trace_thread(const char *name) {
+    if (!trace_enabled)
+        return;
+    trace_ring *r = claim();
+    if (r != NULL)
+        r->thread.store(name, std::memory_order_relaxed);
+}
+
+void trace_record(const char *name, uint64_t begin, uint64_t end, uint32_t arg) {
+    trace_ring *r = claim();
+    if (r == NULL)
+        return;
+    uint64_t head = r->head.load(std::memory_order_relaxed);
+    trace_event &e = r->events[head & (TRACE_EVENTS - 1)];
+    e.name  = name;
+    e.begin = begin;
+    e.end   = end;
+    e.arg   = arg;
+    r->head.store(head + 1, std::memory_order_release);
+}
+
+// A ring's surviving spans, oldest first.
+static void snapshot(const trace_ring *r, std::vector<trace_event> *out) {
+    out->clear();
+    uint64_t head  = r->head.load(std::memory_order_acquire);
+    uint64_t first = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+    for (uint64_t i = first; i < head; i++)
+        out->push_back(r->events[i & (TRACE_EVENTS - 1)]);
+
+    // Drop whatever the thread overwrote while we copied.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t now  = r->head.load(std::memory_order_relaxed);
+    uint64_t safe = now >= TRACE_EVENTS ? now - TRACE_EVENTS + 1 : 0;
+    if (safe > first)
+        out->erase(out->begin(), out->begin() + std::min<uint64_t>(safe - first, out->size()));
+}
+
+bool trace_write(const char *path) {
+    if (!trace_enabled)
+        return false;
+
+    double elapsed_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start_time).count();
+    double ticks_per_us = elapsed_us > 0.0 ? (trace_ticks() - start_ticks) / elapsed_us : 1.0;
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        std::cerr << "Error creating " << path << std::endl;
+        return false;
+    }
+
+    int pid = (int)getpid();
+    size_t written = 0;
+    bool first = true;
+    std::vector<trace_event> events;
+    events.reserve(TRACE_EVENTS);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    int count = std::min(ring_count.load(), TRACE_THREADS);
+    for (int t = 0; t < count; t++) {
+        const char *thread = rings[t].thread.load(std::memory_order_relaxed);
+        fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", pid, t + 1,
+                thread != NULL ? thread : "thread");
+        first = false;
+
+        snapshot(&rings[t], &events);
+        for (size_t i = 0; i < events.size(); i++) {
+            const trace_event &e = events[i];
+            // Spans from before trace_init or torn by a lapping writer.
+            if (e.name == NULL || e.begin < start_ticks || e.end < e.begin)
+                continue;
+            fprintf(file, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    e.name, pid, t + 1, (e.begin - start_ticks) / ticks_per_us,
+                    (e.end - e.begin) / ticks_per_us);
+            if (e.arg != 0)
+                fprintf(file, ",\"args\":{\"n\":%u}", e.arg);
+            fprintf(file, "}");
+            written++;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0) {
+        std::cerr << "Error writing " << path << std::endl;
+        return false;
+    }
+    std::cerr << "Trace: " << written << " spans from " << count << " threads to " << path << std::endl;
+    return true;
+}
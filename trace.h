@@ -0,0 +1,70 @@
+#ifndef RASKOL_TRACE_H
+#define RASKOL_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Timeline tracing for finding which block and which stage missed a
+// deadline. Each thread records scoped spans, timestamped with the TSC,
+// into its own preallocated ring (the newest TRACE_EVENTS survive);
+// trace_write dumps every ring as Chrome trace JSON, which chrome://tracing
+// and Perfetto both open. Until trace_init is called a scope costs a
+// branch.
+
+const int    TRACE_THREADS = 8;
+const size_t TRACE_EVENTS  = 1 << 15;     // per thread, power of two
+
+typedef struct {
+    const char *name;           // string literal
+    uint64_t begin;             // ticks
+    uint64_t end;
+    uint32_t arg;
+}
+trace_event;
+
+extern bool trace_enabled;
+
+inline uint64_t trace_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Allocates the rings and turns tracing on. Call before starting threads.
+void trace_init();
+
+// Names the calling thread in the trace. Threads that never call it get a
+// ring on their first span, named by number.
+void trace_thread(const char *name);
+
+// Appends a finished span to the calling thread's ring. Lock-free and
+// allocation-free; spans are dropped once TRACE_THREADS threads have rings.
+void trace_record(const char *name, uint64_t begin, uint64_t end, uint32_t arg);
+
+// Control thread: writes every ring to `path`. Spans still being written
+// while it copies are skipped.
+bool trace_write(const char *path);
+
+struct trace_scope {
+    const char *name;
+    uint64_t begin;
+    uint32_t arg;
+
+    explicit trace_scope(const char *span, uint32_t value = 0)
+        : name(span), begin(trace_enabled ? trace_ticks() : 0), arg(value) {}
+    ~trace_scope() {
+        if (trace_enabled)
+            trace_record(name, begin, trace_ticks(), arg);
+    }
+};
+
+#endif
@@ -0,0 +1,253 @@
+#include "tuning.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// Physical layout: two chromatic rows, MIDI note numbers.
+static const int KEY_LAYOUT[][2] = {
+    {KEY_A, 48}, {KEY_S, 49}, {KEY_D, 50}, {KEY_F, 51}, {KEY_G, 52}, {KEY_H, 53},
+    {KEY_J, 54}, {KEY_K, 55}, {KEY_L, 56}, {KEY_SEMICOLON, 57}, {KEY_APOSTROPHE, 58},
+    {KEY_BACKSLASH, 59},
+    {KEY_Q, 60}, {KEY_2, 61}, {KEY_W, 62}, {KEY_3, 63}, {KEY_E, 64}, {KEY_R, 65},
+    {KEY_5, 66}, {KEY_T, 67}, {KEY_6, 68}, {KEY_Y, 69}, {KEY_7, 70}, {KEY_U, 71},
+    {KEY_I, 72}, {KEY_9, 73}, {KEY_O, 74}, {KEY_0, 75}, {KEY_P, 76},
+    {KEY_LEFTBRACE, 77}, {KEY_EQUAL, 78}, {KEY_RIGHTBRACE, 79}
+};
+
+static const struct {
+    const char *name;
+    const char *scl;
+} BUILTIN_SCALES[] = {
+    {"12tet",
+     "12-tone equal temperament\n12\n"
+     "100.\n200.\n300.\n400.\n500.\n600.\n700.\n800.\n900.\n1000.\n1100.\n2/1\n"},
+    {"just",
+     "5-limit just intonation\n12\n"
+     "16/15\n9/8\n6/5\n5/4\n4/3\n45/32\n3/2\n8/5\n5/3\n9/5\n15/8\n2/1\n"},
+    {"pythagorean",
+     "Pythagorean\n12\n"
+     "256/243\n9/8\n32/27\n81/64\n4/3\n729/512\n3/2\n128/81\n27/16\n16/9\n243/128\n2/1\n"},
+    {"meantone",
+     "Quarter-comma meantone\n12\n"
+     "76.049\n193.157\n310.265\n386.314\n503.422\n579.471\n696.578\n772.627\n"
+     "889.735\n1006.843\n1082.892\n2/1\n"},
+    {"werckmeister3",
+     "Werckmeister III\n12\n"
+     "90.225\n192.18\n294.135\n390.225\n498.045\n588.27\n696.09\n792.18\n"
+     "888.27\n996.09\n1092.18\n2/1\n"}
+};
+
+static bool read_file(const char *path, std::string *text) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error opening " << path << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    *text = buffer.str();
+    return true;
+}
+
+// Lines starting with '!' are comments in both Scala formats.
+static bool next_line(std::istream &in, std::string *line) {
+    while (std::getline(in, *line)) {
+        if (!line->empty() && (*line)[line->size() - 1] == '\r')
+            line->erase(line->size() - 1);
+        if (line->empty() || (*line)[0] != '!')
+            return true;
+    }
+    return false;
+}
+
+static bool parse_pitch(const std::string &line, double *ratio) {
+    std::string token;
+    std::istringstream(line) >> token;
+    if (token.empty())
+        return false;
+
+    char *end;
+    if (token.find('.') != std::string::npos) {
+        double cents = strtod(token.c_str(), &end);
+        *ratio = pow(2.0, cents / 1200.0);
+        return *end == '\0';
+    }
+
+    long num = strtol(token.c_str(), &end, 10);
+    long den = 1;
+    if (*end == '/')
+        den = strtol(end + 1, &end, 10);
+    if (*end != '\0' || num <= 0 || den <= 0)
+        return false;
+    *ratio = (double)num / den;
+    return true;
+}
+
+bool scale_parse(const std::string &text, const char *name, scale *s) {
+    std::istringstream in(text);
+    std::string line;
+
+    if (!next_line(in, &line)) {
+        std::cerr << name << ": missing description" << std::endl;
+        return false;
+    }
+    s->description = line;
+
+    if (!next_line(in, &line)) {
+        std::cerr << name << ": missing note count" << std::endl;
+        return false;
+    }
+    int count = atoi(line.c_str());
+    if (count <= 0) {
+        std::cerr << name << ": scale needs at least one degree" << std::endl;
+        return false;
+    }
+
+    s->ratios.clear();
+    for (int i = 0; i < count; i++) {
+        double ratio;
+        if (!next_line(in, &line) || !parse_pitch(line, &ratio)) {
+            std::cerr << name << ": bad pitch for degree " << i + 1 << std::endl;
+            return false;
+        }
+        s->ratios.push_back(ratio);
+    }
+    return true;
+}
+
+bool scale_load(const char *path, scale *s) {
+    std::string text;
+    return read_file(path, &text) && scale_parse(text, path, s);
+}
+
+bool scale_builtin(const char *name, scale *s) {
+    for (size_t i = 0; i < sizeof(BUILTIN_SCALES) / sizeof(BUILTIN_SCALES[0]); i++) {
+        if (strcmp(BUILTIN_SCALES[i].name, name) == 0)
+            return scale_parse(BUILTIN_SCALES[i].scl, name, s);
+    }
+    return false;
+}
+
+void keyboard_map_defaults(keyboard_map *m) {
+    m->map_size            = 0;
+    m->first_note          = 0;
+    m->last_note           = 127;
+    m->middle_note         = 60;
+    m->reference_note      = 69;
+    m->reference_frequency = 440.0;
+    m->octave_degree       = 0;
+    m->mapping.clear();
+}
+
+bool keyboard_map_load(const char *path, keyboard_map *m) {
+    std::string text;
+    if (!read_file(path, &text))
+        return false;
+
+    std::istringstream in(text);
+    std::string line;
+    double header[7];
+
+    for (int i = 0; i < 7; i++) {
+        char *end;
+        if (!next_line(in, &line)) {
+            std::cerr << path << ": truncated header" << std::endl;
+            return false;
+        }
+        header[i] = strtod(line.c_str(), &end);
+        if (end == line.c_str()) {
+            std::cerr << path << ": bad header line " << i + 1 << std::endl;
+            return false;
+        }
+    }
+
+    keyboard_map next;
+    next.map_size            = (int)header[0];
+    next.first_note          = (int)header[1];
+    next.last_note           = (int)header[2];
+    next.middle_note         = (int)header[3];
+    next.reference_note      = (int)header[4];
+    next.reference_frequency = header[5];
+    next.octave_degree       = (int)header[6];
+
+    if (next.map_size < 0 || next.reference_frequency <= 0.0) {
+        std::cerr << path << ": bad header" << std::endl;
+        return false;
+    }
+
+    // Missing trailing entries are unmapped, as in Scala.
+    for (int i = 0; i < next.map_size; i++) {
+        if (!next_line(in, &line) || line.empty() || line[0] == 'x')
+            next.mapping.push_back(-1);
+        else
+            next.mapping.push_back(atoi(line.c_str()));
+    }
+
+    *m = next;
+    return true;
+}
+
+static int floor_div(int a, int b) {
+    int q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+static double degree_ratio(const scale &s, int degree) {
+    int size    = (int)s.ratios.size();
+    int octave  = floor_div(degree, size);
+    int step    = degree - octave * size;
+    double base = step == 0 ? 1.0 : s.ratios[step - 1];
+    return pow(s.ratios[size - 1], octave) * base;
+}
+
+// Ratio of a note against the middle note, or 0 if unmapped.
+static double note_ratio(const scale &s, const keyboard_map &m, int note) {
+    int offset = note - m.middle_note;
+    if (m.map_size == 0)
+        return degree_ratio(s, offset);
+
+    int octave = floor_div(offset, m.map_size);
+    int degree = m.mapping[offset - octave * m.map_size];
+    if (degree < 0)
+        return 0.0;
+
+    double period = m.octave_degree == 0 ? s.ratios.back() : degree_ratio(s, m.octave_degree);
+    return pow(period, octave) * degree_ratio(s, degree);
+}
+
+double tuning_note_frequency(const scale &s, const keyboard_map &m, int note) {
+    if (note < m.first_note || note > m.last_note)
+        return 0.0;
+
+    double ratio = note_ratio(s, m, note);
+    if (ratio == 0.0)
+        return 0.0;
+
+    double reference = note_ratio(s, m, m.reference_note);
+    if (reference == 0.0)
+        reference = degree_ratio(s, m.reference_note - m.middle_note);
+    return m.reference_frequency * ratio / reference;
+}
+
+void tuning_compile(tuning *t, const scale &s, const keyboard_map &m, int sample_rate) {
+    for (int i = 0; i < TUNING_KEYS; i++) {
+        t->frequency[i]       = 0.0f;
+        t->phase_increment[i] = 0.0f;
+    }
+
+    for (size_t i = 0; i < sizeof(KEY_LAYOUT) / sizeof(KEY_LAYOUT[0]); i++) {
+        double frequency = tuning_note_frequency(s, m, KEY_LAYOUT[i][1]);
+        t->frequency[KEY_LAYOUT[i][0]]       = (float)frequency;
+        t->phase_increment[KEY_LAYOUT[i][0]] = (float)(2.0 * M_PI * frequency / sample_rate);
+    }
+
+    for (int note = 0; note < TUNING_NOTES; note++) {
+        double frequency = tuning_note_frequency(s, m, note);
+        t->note_frequency[note] = (float)frequency;
+        t->note_increment[note] = (float)(2.0 * M_PI * frequency / sample_rate);
+    }
+}
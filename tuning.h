@@ -0,0 +1,54 @@
+#ifndef RASKOL_TUNING_H
+#define RASKOL_TUNING_H
+
+#include <linux/input.h>
+#include <string>
+#include <vector>
+
+// Scala scales (.scl) and keyboard mappings (.kbm) are compiled into flat
+// tables indexed by evdev keycode, so a key event costs one array load.
+
+const int TUNING_KEYS  = KEY_MAX + 1;
+const int TUNING_NOTES = 128;          // MIDI notes, for other control sources
+
+typedef struct {
+    std::string description;
+    std::vector<double> ratios;     // degrees 1..n; the last one is the period
+}
+scale;
+
+typedef struct {
+    int    map_size;
+    int    first_note;
+    int    last_note;
+    int    middle_note;
+    int    reference_note;
+    double reference_frequency;
+    int    octave_degree;
+    std::vector<int> mapping;       // scale degree per key, -1 if unmapped
+}
+keyboard_map;
+
+typedef struct {
+    float frequency[TUNING_KEYS];        // 0 for keys that do not play
+    float phase_increment[TUNING_KEYS];  // radians per sample
+    float note_frequency[TUNING_NOTES];
+    float note_increment[TUNING_NOTES];
+}
+tuning;
+
+bool scale_parse(const std::string &text, const char *name, scale *s);
+bool scale_load(const char *path, scale *s);
+
+// 12tet, just, pythagorean, meantone or werckmeister3.
+bool scale_builtin(const char *name, scale *s);
+
+void keyboard_map_defaults(keyboard_map *m);
+bool keyboard_map_load(const char *path, keyboard_map *m);
+
+// Frequency of a MIDI note, or 0 if the mapping leaves it unmapped.
+double tuning_note_frequency(const scale &s, const keyboard_map &m, int note);
+
+void tuning_compile(tuning *t, const scale &s, const keyboard_map &m, int sample_rate);
+
+#endif
@@ -0,0 +1,170 @@
+#include "voice_rate.h"
+
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// 2^exponent, for exponents a normal double holds.
+static double power_of_two(int exponent) {
+    uint64_t bits = (uint64_t)(exponent + 1023) << 52;
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static double wrap(double phase) {
+    return phase - 2.0 * M_PI * std::floor(phase / (2.0 * M_PI));
+}
+
+void voice_rates_init(voice_rates *r, float dx) {
+    // Lagrange weights for nodes -2..3 at each fraction r / factor.
+    for (int shift = 0; shift < VOICE_RATES; shift++) {
+        int factor = 1 << shift;
+        for (int phase = 0; phase < factor; phase++) {
+            double f = (double)phase / factor;
+            for (int j = 0; j < 6; j++) {
+                double w = 1.0;
+                for (int m = 0; m < 6; m++) {
+                    if (m != j)
+                        w *= (f - (m - 2)) / (double)(j - m);
+                }
+                r->taps[shift][j * factor + phase] = (float)w;
+            }
+        }
+    }
+
+    // Below full volume the envelope is linear in (1 - volume, d_volume):
+    // one sample is [[1, -dx], [dx, 1 - dx^2]].
+    double d = dx;
+    double step[4] = {1.0, -d, d, 1.0 - d * d};
+    double m[4]    = {1.0, 0.0, 0.0, 1.0};
+    for (int i = 0; i <= (1 << ENVELOPE_SHIFT); i++) {
+        for (int j = 0; j < 4; j++)
+            r->steps[i][j] = m[j];
+        double next[4] = {
+            step[0] * m[0] + step[1] * m[2], step[0] * m[1] + step[1] * m[3],
+            step[2] * m[0] + step[3] * m[2], step[2] * m[1] + step[3] * m[3]
+        };
+        for (int j = 0; j < 4; j++)
+            m[j] = next[j];
+    }
+}
+
+int voice_rate(int waveform, float increment) {
+    int harmonics = waveform == 0 ? 1 : (waveform == 2 ? 7 : 0);
+    if (harmonics == 0)
+        return 0;
+    float top = increment * harmonics;
+    int shift = 0;
+    while (shift + 1 < VOICE_RATES && top * (2 << shift) <= VOICE_BANDWIDTH)
+        shift++;
+    return shift;
+}
+
+void voice_oscillator(const voice_rates *r, const dsp_kernels *k, int waveform, float *phase, float increment,
+                      int shift, float *low, float *wave, unsigned long n) {
+    int factor = 1 << shift;
+    float start = (float)wrap(*phase - 2.0 * factor * increment);
+    k->oscillator(waveform, &start, increment * factor, low, ((n - 1) >> shift) + 6);
+    k->upsample(low, r->taps[shift], factor, wave, n);
+    voice_skip(phase, increment, n);
+}
+
+static void apply(const double *m, double *u, double *dv) {
+    double a = m[0] * *u + m[1] * *dv;
+    double b = m[2] * *u + m[3] * *dv;
+    *u  = a;
+    *dv = b;
+}
+
+bool voice_envelope(const voice_rates *r, float *volume, float *d_volume, float dx, float *out, unsigned long n) {
+    const unsigned long step = 1 << ENVELOPE_SHIFT;
+
+    // Sustain: volume pinned at 1 while d_volume runs down, which takes
+    // minutes.
+    if (*volume >= 1.0f) {
+        if (*d_volume < 0.01f * dx * n)
+            return false;
+        for (unsigned long i = 0; i < n; i++)
+            out[i] = 1.0f;
+        *d_volume -= 0.01f * dx * n;
+        return true;
+    }
+
+    // Attack: out[i] is the volume after i + 1 samples. Every point must
+    // stay inside [0, 1), where the recurrence is linear.
+    double u  = 1.0 - *volume;
+    double dv = *d_volume;
+    for (unsigned long at = 0; at < n; at += step) {
+        double nu = u, ndv = dv;
+        apply(r->steps[step], &nu, &ndv);
+        double before = 1.0 - u;
+        double after  = 1.0 - nu;
+        if (after >= 1.0 || after < 0.0)
+            return false;
+
+        unsigned long count = n - at < step ? n - at : step;
+        for (unsigned long i = 0; i < count; i++)
+            out[at + i] = (float)(before + (after - before) * (double)(i + 1) / step);
+        if (count < step) {
+            nu  = u;
+            ndv = dv;
+            apply(r->steps[count], &nu, &ndv);
+        }
+        u  = nu;
+        dv = ndv;
+    }
+    *volume   = (float)(1.0 - u);
+    *d_volume = (float)dv;
+    return true;
+}
+
+// The scalar render's per-sample `phase += increment`, wrapped at 2 pi in
+// double. A float is a multiple of its own ulp, and every add that stays
+// in its binade rounds the increment the same way, so a run of them up to
+// the next power of two or the wrap is one multiply. Steps that cross
+// those, or that hit a tie, are taken one at a time. The result is
+// bit-identical.
+void voice_skip(float *phase, float increment, unsigned long n) {
+    const double turn = 2.0 * M_PI;
+    float ph = *phase;
+    while (n > 0) {
+        // Just after a wrap the binades are narrower than a step: add.
+        unsigned long steps = 0;
+        if (ph >= 4.0f * increment && ph >= FLT_MIN && increment > 0.0f) {
+            // In units of the phase's ulp, as integers.
+            uint32_t bits;
+            memcpy(&bits, &ph, sizeof(bits));
+            int     exponent = (int)(bits >> 23) - 127;
+            double  per_ulp  = power_of_two(23 - exponent);
+            int64_t at       = (int64_t)(ph * per_ulp);
+            double  units    = increment * per_ulp;
+            int64_t step     = units < 16777216.0 ? (int64_t)(units + 0.5) : 0;
+            if (step - units == 0.5) {
+                // A tie goes to even: consistent only from an even phase,
+                // and one step gets there.
+                step = at & 1 ? 0 : step - (step & 1);
+            }
+
+            // Last value the run may reach: below the next power of two,
+            // and below the wrap.
+            int64_t last = (1 << 24) - 1;
+            if (ph < turn && turn < power_of_two(exponent + 1))
+                last = std::min(last, (int64_t)(turn * per_ulp));
+            if (step > 0 && last > at) {
+                steps = std::min<unsigned long>((uint32_t)(last - at) / (uint32_t)step, n);
+                ph = (float)((double)(at + (int64_t)steps * step) * power_of_two(exponent - 23));
+                n -= steps;
+            }
+        }
+        if (steps == 0 && n > 0) {
+            ph += increment;
+            if (ph >= turn)
+                ph = (float)(ph - turn);
+            n--;
+        }
+    }
+    *phase = ph;
+}
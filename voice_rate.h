@@ -0,0 +1,48 @@
+#ifndef RASKOL_VOICE_RATE_H
+#define RASKOL_VOICE_RATE_H
+
+#include "kernels.h"
+
+// Multi-rate voices. A voice whose top harmonic is low enough runs its
+// oscillator at 1/2, 1/4 or 1/8 of the rate, and a 6-point Lagrange
+// interpolator brings it back up. The low-rate points are computed from
+// the phase, which is known ahead, so nothing is delayed and a voice can
+// change rate between any two blocks. The envelope is smooth whatever the
+// waveform and is evaluated every 8 samples for every voice.
+
+const int   VOICE_RATES     = 4;          // full, 1/2, 1/4, 1/8
+const int   ENVELOPE_SHIFT  = 3;          // envelope points every 8 samples
+
+// Highest harmonic a decimated voice may have, in radians per low-rate
+// sample; the interpolator's error on a sine stays under 2e-5 below it.
+const float VOICE_BANDWIDTH = 0.4f;
+
+typedef struct {
+    float  taps[VOICE_RATES][8 * 6];    // per rate: each of 6 taps for every output phase
+    double steps[(1 << ENVELOPE_SHIFT) + 1][4];  // attack recurrence over 0-8 samples
+}
+voice_rates;
+
+void voice_rates_init(voice_rates *r, float dx);
+
+// log2 of the decimation for a voice: 0 for full rate, up to 3. Only the
+// sine and the four-harmonic square have a known top harmonic.
+int voice_rate(int waveform, float increment);
+
+// Fills wave with n samples of the oscillator at 1/2^shift of the rate
+// (shift >= 1) and advances *phase by n increments. `low` holds
+// ((n - 1) >> shift) + 6 floats.
+void voice_oscillator(const voice_rates *r, const dsp_kernels *k, int waveform, float *phase, float increment,
+                      int shift, float *low, float *wave, unsigned long n);
+
+// The envelope kernel's output, from the exact recurrence every 8 samples
+// with linear interpolation in between. Works while the attack stays
+// under full volume or the sustain holds; false otherwise, with nothing
+// changed, and the caller runs the per-sample kernel.
+bool voice_envelope(const voice_rates *r, float *volume, float *d_volume, float dx, float *out, unsigned long n);
+
+// Advances *phase by n increments exactly as the per-sample render would,
+// wraps included, in a few steps.
+void voice_skip(float *phase, float increment, unsigned long n);
+
+#endif
@@ -0,0 +1,143 @@
+#include "wav.h"
+
+#include <iostream>
+#include <cstring>
+
+static const uint16_t WAVE_FORMAT_PCM        = 1;
+static const uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+static const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xfffe;
+
+static void put_u16(unsigned char *p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (v >> (8 * i)) & 0xff;
+}
+
+void wav_fill_header(unsigned char *h, size_t size, int sample_rate, int channels, uint64_t frames) {
+    uint32_t data_bytes = (uint32_t)(frames * channels * 4);
+    memset(h, 0, size);
+    memcpy(h, "RIFF", 4);
+    put_u32(h + 4, (uint32_t)(size - 8) + data_bytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put_u32(h + 16, 16);
+    put_u16(h + 20, WAVE_FORMAT_IEEE_FLOAT);
+    put_u16(h + 22, channels);
+    put_u32(h + 24, sample_rate);
+    put_u32(h + 28, sample_rate * channels * 4);
+    put_u16(h + 32, channels * 4);
+    put_u16(h + 34, 32);
+    if (size > 44) {
+        memcpy(h + 36, "JUNK", 4);
+        put_u32(h + 40, (uint32_t)(size - 52));
+    }
+    memcpy(h + size - 8, "data", 4);
+    put_u32(h + size - 4, data_bytes);
+}
+
+bool wav_create(wav_writer *w, const char *path, int sample_rate, int channels) {
+    w->file = fopen(path, "wb");
+    if (w->file == NULL) {
+        std::cerr << "Error creating " << path << std::endl;
+        return false;
+    }
+    w->channels    = channels;
+    w->sample_rate = sample_rate;
+    w->frames      = 0;
+
+    unsigned char header[44];
+    wav_fill_header(header, sizeof(header), w->sample_rate, w->channels, w->frames);
+    return fwrite(header, sizeof(header), 1, w->file) == 1;
+}
+
+bool wav_write(wav_writer *w, const float *samples, unsigned long frames) {
+    size_t count = frames * w->channels;
+    if (fwrite(samples, sizeof(float), count, w->file) != count)
+        return false;
+    w->frames += frames;
+    return true;
+}
+
+bool wav_close(wav_writer *w) {
+    unsigned char header[44];
+    wav_fill_header(header, sizeof(header), w->sample_rate, w->channels, w->frames);
+    bool ok = fseek(w->file, 0, SEEK_SET) == 0 && fwrite(header, sizeof(header), 1, w->file) == 1;
+    ok = fclose(w->file) == 0 && ok;
+    w->file = NULL;
+    return ok;
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t get_u16(const unsigned char *p) {
+    return p[0] | p[1] << 8;
+}
+
+static float get_sample(const unsigned char *p, uint16_t format, int bits) {
+    if (format == WAVE_FORMAT_IEEE_FLOAT) {
+        float f;
+        memcpy(&f, p, 4);
+        return f;
+    }
+    switch (bits) {
+    case 16: return (int16_t)get_u16(p) / 32768.0f;
+    case 24: return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) / 2147483648.0f;
+    default: return (int32_t)get_u32(p) / 2147483648.0f;
+    }
+}
+
+bool wav_load(const char *path, std::vector<float> *samples, int *sample_rate) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        std::cerr << "Error opening " << path << std::endl;
+        return false;
+    }
+
+    unsigned char header[12], chunk[8], fmt[40];
+    uint16_t format = 0, channels = 0, bits = 0;
+    bool ok = fread(header, sizeof(header), 1, file) == 1 &&
+              memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WAVE", 4) == 0;
+    while (ok && fread(chunk, sizeof(chunk), 1, file) == 1) {
+        uint32_t size = get_u32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            size_t read = size < sizeof(fmt) ? size : sizeof(fmt);
+            ok = fread(fmt, read, 1, file) == 1 && fseek(file, (size - read) + (size & 1), SEEK_CUR) == 0;
+            format       = get_u16(fmt);
+            channels     = get_u16(fmt + 2);
+            *sample_rate = (int)get_u32(fmt + 4);
+            bits         = get_u16(fmt + 14);
+            if (format == WAVE_FORMAT_EXTENSIBLE && read >= 26)
+                format = get_u16(fmt + 24);
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            bool pcm = format == WAVE_FORMAT_PCM && (bits == 16 || bits == 24 || bits == 32);
+            bool fl  = format == WAVE_FORMAT_IEEE_FLOAT && bits == 32;
+            if (channels == 0 || (!pcm && !fl)) {
+                std::cerr << "Unsupported WAV format in " << path << std::endl;
+                fclose(file);
+                return false;
+            }
+            size_t frame = channels * (bits / 8);
+            std::vector<unsigned char> data(size);
+            size = (uint32_t)fread(data.data(), 1, size, file);
+            samples->assign(size / frame, 0.0f);
+            for (size_t i = 0; i < samples->size(); i++) {
+                float sum = 0.0f;
+                for (int c = 0; c < channels; c++)
+                    sum += get_sample(&data[i * frame + c * (bits / 8)], format, bits);
+                (*samples)[i] = sum / channels;
+            }
+            fclose(file);
+            return true;
+        } else {
+            ok = fseek(file, size + (size & 1), SEEK_CUR) == 0;
+        }
+    }
+    fclose(file);
+    std::cerr << "Error reading " << path << ": not a WAV file" << std::endl;
+    return false;
+}
@@ -0,0 +1,31 @@
+#ifndef RASKOL_WAV_H
+#define RASKOL_WAV_H
+
+#include <cstddef>
+#include <cstdio>
+#include <stdint.h>
+#include <vector>
+
+// 32-bit float WAV writer. Sizes in the header are patched on close.
+
+typedef struct {
+    FILE *file;
+    int channels;
+    int sample_rate;
+    uint32_t frames;
+}
+wav_writer;
+
+// Header for a float WAV whose samples start at `size` bytes (44, or more
+// with a JUNK chunk filling the gap, so the data can start on a block
+// boundary).
+void wav_fill_header(unsigned char *h, size_t size, int sample_rate, int channels, uint64_t frames);
+
+bool wav_create(wav_writer *w, const char *path, int sample_rate, int channels);
+bool wav_write(wav_writer *w, const float *samples, unsigned long frames);
+bool wav_close(wav_writer *w);
+
+// Reads a 16, 24 or 32-bit integer or 32-bit float WAV, mixed down to mono.
+bool wav_load(const char *path, std::vector<float> *samples, int *sample_rate);
+
+#endif
@@ -0,0 +1,99 @@
+#include "waveguide.h"
+
+#include <cmath>
+#include <algorithm>
+
+void strings_init(string_bank *s, int voices) {
+    string_voice idle = {0, 1, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    s->voices.assign(voices, idle);
+    s->lines.assign(voices * STRING_DELAY, 0.0f);
+    s->random = 0x2545f491u;
+}
+
+void string_tune(string_bank *s, int voice, const patch *p, float frequency, int sample_rate) {
+    string_voice &v = s->voices[voice];
+
+    // Loss per period for -60 dB in string_decay seconds. The loss filter
+    // also attenuates the fundamental, by sqrt(1 - 2b(1-b)(1 - cos w));
+    // high notes get a smaller blend so that alone never exceeds it.
+    double w      = 2.0 * M_PI * frequency / sample_rate;
+    double target = std::pow(10.0, -3.0 / (p->string_decay * frequency));
+    double most   = (1.0 - target * target) / (2.0 * (1.0 - std::cos(w)));
+    double blend  = 0.5 * (1.0 - p->string_brightness);
+    if (most < 0.25)
+        blend = std::min(blend, 0.5 * (1.0 - std::sqrt(1.0 - 4.0 * most)));
+    double response = std::sqrt(1.0 - 2.0 * blend * (1.0 - blend) * (1.0 - std::cos(w)));
+
+    // The allpass covers what the line and the loss filter leave of the
+    // period, kept within 0.1-1.1 samples. Both delays are taken at the
+    // fundamental itself, so high notes stay in tune too.
+    double period   = std::min(std::max((double)sample_rate / frequency, 2.0), (double)(STRING_DELAY - 2));
+    double loss     = std::atan2(blend * std::sin(w), 1.0 - blend + blend * std::cos(w)) / w;
+    double rest     = period - loss;
+    unsigned whole  = std::max((unsigned)(rest - 0.1), 1u);
+    double fraction = rest - whole;
+
+    v.delay   = whole;
+    v.gain    = (float)std::min(target / std::max(response, 1e-3), 0.99999);
+    v.blend   = (float)blend;
+    v.allpass = (float)(std::sin(0.5 * (1.0 - fraction) * w) / std::sin(0.5 * (1.0 + fraction) * w));
+}
+
+// Uniform in [-1, 1).
+static float next_random(string_bank *s) {
+    s->random ^= s->random << 13;
+    s->random ^= s->random >> 17;
+    s->random ^= s->random << 5;
+    return (float)(s->random >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+void string_excite(string_bank *s, int voice, const patch *p, float frequency, int sample_rate) {
+    string_tune(s, voice, p, frequency, sample_rate);
+    string_voice &v = s->voices[voice];
+    float *line = &s->lines[voice * STRING_DELAY];
+
+    if (p->string_excite == STRING_STRIKE) {
+        // A hammer: one raised-cosine bump a quarter of the period wide.
+        unsigned width = std::max(v.delay / 4, 2u);
+        std::fill(line, line + v.delay, 0.0f);
+        for (unsigned i = 0; i < width; i++)
+            line[i] = 0.5f - 0.5f * std::cos(2.0f * (float)M_PI * i / width);
+    } else {
+        // A pick: noise.
+        for (unsigned i = 0; i < v.delay; i++)
+            line[i] = next_random(s);
+    }
+
+    // The loop passes DC almost unchanged; remove it so the string does
+    // not start with an offset.
+    float mean = 0.0f;
+    for (unsigned i = 0; i < v.delay; i++)
+        mean += line[i];
+    mean /= v.delay;
+    for (unsigned i = 0; i < v.delay; i++)
+        line[i] -= mean;
+
+    v.write   = v.delay;
+    v.last_in = 0.0f;
+    v.ap_in   = 0.0f;
+    v.ap_out  = 0.0f;
+}
+
+// string_tick with the voice held in locals; stores to the line could
+// otherwise alias it and force reloads every sample.
+void string_render(string_bank *s, int voice, float *out, unsigned long n) {
+    string_voice v = s->voices[voice];
+    float *line = &s->lines[voice * STRING_DELAY];
+    for (unsigned long i = 0; i < n; i++) {
+        float x    = line[(v.write - v.delay) & (STRING_DELAY - 1)];
+        float loss = v.gain * ((1.0f - v.blend) * x + v.blend * v.last_in);
+        float y    = v.allpass * (loss - v.ap_out) + v.ap_in;
+        v.last_in = x;
+        v.ap_in   = loss;
+        v.ap_out  = y;
+        line[v.write & (STRING_DELAY - 1)] = y;
+        v.write++;
+        out[i] = y;
+    }
+    s->voices[voice] = v;
+}
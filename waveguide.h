@@ -0,0 +1,63 @@
+#ifndef RASKOL_WAVEGUIDE_H
+#define RASKOL_WAVEGUIDE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "patch.h"
+
+// Plucked and struck strings (extended Karplus-Strong). Each voice is a
+// delay line, masked to a power of two, closed by a two-tap loss filter
+// (brightness and decay) and a first-order allpass that supplies the
+// fractional part of the period, so every note is tuned exactly. The
+// lines live in one block allocated up front, one per note slot.
+
+const size_t STRING_DELAY = 2048;         // per voice; lowest note ~21.5 Hz at 44.1 kHz
+
+typedef struct {
+    unsigned write;
+    unsigned delay;             // whole samples of the period
+    float    gain;              // loss per trip round the loop
+    float    blend;             // loss filter's second tap; more is darker
+    float    allpass;           // coefficient for the fractional delay
+    float    last_in;           // loss filter input, one sample back
+    float    ap_in;             // allpass input and output, one sample back
+    float    ap_out;
+}
+string_voice;
+
+typedef struct {
+    std::vector<string_voice> voices;
+    std::vector<float> lines;   // voices.size() * STRING_DELAY
+    uint32_t random;
+}
+string_bank;
+
+void strings_init(string_bank *s, int voices);
+
+// Sets the period and loss for `frequency`, keeping the line's contents.
+void string_tune(string_bank *s, int voice, const patch *p, float frequency, int sample_rate);
+
+// Tunes the voice and fills its line with the patch's excitation.
+void string_excite(string_bank *s, int voice, const patch *p, float frequency, int sample_rate);
+
+// One sample: read the period back, lose a little, fine-tune, write.
+inline float string_tick(string_bank *s, int voice) {
+    string_voice &v = s->voices[voice];
+    float *line = &s->lines[voice * STRING_DELAY];
+    float x    = line[(v.write - v.delay) & (STRING_DELAY - 1)];
+    float loss = v.gain * ((1.0f - v.blend) * x + v.blend * v.last_in);
+    float y    = v.allpass * (loss - v.ap_out) + v.ap_in;
+    v.last_in = x;
+    v.ap_in   = loss;
+    v.ap_out  = y;
+    line[v.write & (STRING_DELAY - 1)] = y;
+    v.write++;
+    return y;
+}
+
+// Writes n samples of the voice to out.
+void string_render(string_bank *s, int voice, float *out, unsigned long n);
+
+#endif